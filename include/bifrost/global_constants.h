@@ -11,6 +11,9 @@ enum refresh_type : int {
     MONOCHROME_PENCIL = -1,
     COLOR_1 = -2,
     COLOR_2 = -3,
+
+    // let the compositor pick the fastest waveform for the content
+    AUTO = -4,
 };
 
 #endif // GLOBAL_CONSTANTS_H
\ No newline at end of file
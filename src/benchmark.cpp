@@ -0,0 +1,421 @@
+#include "benchmark.h"
+
+#include "constants.h"
+#include "gui/ComicArchive.h"
+#include "gui/ImageResampler.h"
+#include "gui/MappedFile.h"
+#include "gui/PageDiskCache.h"
+#include "gui/PagePrefetcher.h"
+#include "gui/ZipReader.h"
+#include "utils/dither.h"
+#include "utils/stats.h"
+
+#include <archive.h>
+#include <archive_entry.h>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+struct timing {
+    double mean_ms = 0;
+    double min_ms = 0;
+    double max_ms = 0;
+};
+
+timing measure(int iterations, const std::function<void()>& fn)
+{
+    timing result;
+    double total = 0;
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        total += ms;
+        result.min_ms = i == 0 ? ms : std::min(result.min_ms, ms);
+        result.max_ms = std::max(result.max_ms, ms);
+    }
+    result.mean_ms = total / iterations;
+    return result;
+}
+
+void report(const char* name, const timing& t)
+{
+    spdlog::info("benchmark {}: {:.2f} ms mean, {:.2f} ms min, {:.2f} ms max", name, t.mean_ms, t.min_ms, t.max_ms);
+}
+
+void report_throughput(const char* name, const timing& t, double megapixels)
+{
+    spdlog::info("benchmark {}: {:.2f} ms mean, {:.1f} MP/s ({:.2f} ms per MP)", name, t.mean_ms,
+                 megapixels * 1000 / t.mean_ms, t.mean_ms / megapixels);
+}
+
+// invalidate a full-screen object and time the synchronous redraw, flush included
+timing measure_redraw(lv_obj_t* root, int iterations)
+{
+    return measure(iterations, [root] {
+        lv_obj_invalidate(root);
+        lv_refr_now(nullptr);
+    });
+}
+
+void benchmark_lvgl(const std::shared_ptr<lvgl_renderer>&)
+{
+    g_ui_tasks.run([] {
+        constexpr int iterations = 20;
+        spdlog::info("benchmark lvgl: {} software draw units", LV_DRAW_SW_DRAW_UNIT_CNT);
+
+        auto list = lv_list_create(lv_layer_top());
+        lv_obj_set_size(list, LV_PCT(100), LV_PCT(100));
+        for (int i = 0; i < 40; i++) {
+            auto btn = lv_list_add_btn(list, LV_SYMBOL_FILE, ("Benchmark entry " + std::to_string(i)).c_str());
+            lv_obj_set_style_text_font(btn, &lv_font_montserrat_30, 0);
+        }
+        report("lvgl/list", measure_redraw(list, iterations));
+        lv_obj_delete(list);
+
+        auto labels = lv_obj_create(lv_layer_top());
+        lv_obj_set_size(labels, LV_PCT(100), LV_PCT(100));
+        lv_obj_set_flex_flow(labels, LV_FLEX_FLOW_COLUMN);
+        for (int i = 0; i < 30; i++) {
+            auto label = lv_label_create(labels);
+            lv_label_set_text(label, "The quick brown fox jumps over the lazy dog. Sphinx of black quartz, judge my vow.");
+            lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+            lv_obj_set_width(label, LV_PCT(100));
+            lv_obj_set_style_text_font(label, &lv_font_montserrat_40, 0);
+        }
+        report("lvgl/labels", measure_redraw(labels, iterations));
+        lv_obj_delete(labels);
+    });
+}
+
+// full-screen gray gradient with a color band, dithered in place. Later passes see already
+// dithered pixels, which costs the same per pixel for both methods.
+void benchmark_dither(const std::shared_ptr<lvgl_renderer>&)
+{
+    constexpr int iterations = 10;
+    const std::pair<const char*, dither_mode> modes[] = {
+        { "dither/ordered_bw", { dither_method::ORDERED, dither_palette::BLACK_WHITE } },
+        { "dither/ordered_primaries", { dither_method::ORDERED, dither_palette::PRIMARIES } },
+        { "dither/diffusion_bw", { dither_method::ERROR_DIFFUSION, dither_palette::BLACK_WHITE } },
+        { "dither/diffusion_primaries", { dither_method::ERROR_DIFFUSION, dither_palette::PRIMARIES } },
+    };
+
+    std::vector<uint32_t> source(SCREEN_WIDTH * SCREEN_HEIGHT);
+    for (uint32_t y = 0; y < SCREEN_HEIGHT; y++) {
+        for (uint32_t x = 0; x < SCREEN_WIDTH; x++) {
+            uint32_t gray = x * 255 / SCREEN_WIDTH;
+            source[y * SCREEN_WIDTH + x] = y < SCREEN_HEIGHT / 2 ? 0xff000000u | gray * 0x010101u
+                                                                 : 0xff000000u | (gray << 16) | ((255 - gray) << 8) | (y & 0xff);
+        }
+    }
+
+    ditherer dither(SCREEN_WIDTH);
+    rect screen = { { 0, 0 }, { SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1 } };
+    double megapixels = SCREEN_WIDTH * SCREEN_HEIGHT / 1e6;
+    for (const auto& [name, mode] : modes) {
+        auto pixels = source;
+        dither.set_mode(mode);
+        report_throughput(name, measure(iterations, [&] {
+            dither.dither_region(reinterpret_cast<uint8_t*>(pixels.data()), SCREEN_WIDTH * 4, screen);
+        }), megapixels);
+    }
+}
+
+// the original non-separable float Lanczos filter (with unsigned samples), kept as the baseline
+void resize_lanczos_reference(const uint8_t* src, size_t src_stride, int src_w, int src_h, uint8_t* dst, int tgt_w, int tgt_h, int channels)
+{
+    constexpr int a = 3;
+    auto kernel = [](float x) {
+        if (x == 0.0f) return 1.0f;
+        if (std::abs(x) >= a) return 0.0f;
+        x *= M_PI;
+        return (a * std::sin(x) * std::sin(x / a)) / (x * x);
+    };
+
+    for (int y = 0; y < tgt_h; y++) {
+        for (int x = 0; x < tgt_w; x++) {
+            float src_x = static_cast<float>(x * src_w) / tgt_w;
+            float src_y = static_cast<float>(y * src_h) / tgt_h;
+            float sum[4] = { 0, 0, 0, 0 };
+            float weight_sum = 0;
+            for (int ky = -a; ky <= a; ky++) {
+                int sy = std::clamp(static_cast<int>(src_y) + ky, 0, src_h - 1);
+                for (int kx = -a; kx <= a; kx++) {
+                    int sx = std::clamp(static_cast<int>(src_x) + kx, 0, src_w - 1);
+                    float weight = kernel(src_x - sx) * kernel(src_y - sy);
+                    weight_sum += weight;
+                    for (int c = 0; c < channels; c++) {
+                        sum[c] += weight * src[sy * src_stride + sx * channels + c];
+                    }
+                }
+            }
+            for (int c = 0; c < channels; c++) {
+                dst[(y * tgt_w + x) * channels + c] = std::clamp(static_cast<int>(std::lround(sum[c] / weight_sum)), 0, 255);
+            }
+        }
+    }
+}
+
+// decoded pages from BIFROST_BENCHMARK_COMIC, or a synthetic page with hard edges and gradients
+std::vector<Image> benchmark_pages(uint32_t max_pages)
+{
+    std::vector<Image> pages;
+    if (auto path = std::getenv(ENV_BENCHMARK_COMIC)) {
+        std::unique_ptr<ComicArchive> archive(ComicArchive::Create(path));
+        for (uint32_t id = 0; archive && id < std::min(max_pages, archive->GetImageCount()); id++) {
+            Image page;
+            if (archive->GetImage(id, 0, page, PixelFormat::ARGB8888)) {
+                pages.push_back(std::move(page));
+            }
+        }
+    }
+    if (pages.empty()) {
+        spdlog::info("benchmark: {} not set or unreadable, using a synthetic page", ENV_BENCHMARK_COMIC);
+        Image page(1988, 3056, PixelFormat::ARGB8888);
+        for (int y = 0; y < page.height; y++) {
+            uint8_t* row = page.Row(y);
+            for (int i = 0; i < page.width * 4; i++) {
+                int x = i / 4;
+                row[i] = ((x / 40 + y / 40) & 1) ? x * 255 / page.width : 255 - y * 255 / page.height;
+            }
+        }
+        pages.push_back(std::move(page));
+    }
+    return pages;
+}
+
+// scale comic pages to the screen height with the baseline and the separable resampler. The
+// separable kernel is widened for the downscale, so the two outputs no longer match exactly.
+void benchmark_resample(const std::shared_ptr<lvgl_renderer>&)
+{
+    constexpr int iterations = 3;
+    for (const auto& page : benchmark_pages(3)) {
+        int channels = BytesPerPixel(page.format);
+        int tgt_h = SCREEN_HEIGHT;
+        int tgt_w = tgt_h * page.width / page.height;
+        auto src = page.Row(0);
+        std::vector<uint8_t> reference(tgt_w * tgt_h * channels);
+        std::vector<uint8_t> resized(reference.size());
+        spdlog::info("benchmark resample: {}x{} ({} channels) to {}x{}", page.width, page.height, channels, tgt_w, tgt_h);
+
+        auto baseline = measure(1, [&] { resize_lanczos_reference(src, page.stride, page.width, page.height, reference.data(), tgt_w, tgt_h, channels); });
+        report("resample/reference", baseline);
+        auto separable = measure(iterations, [&] {
+            LanczosResampler(page.width, page.height, tgt_w, tgt_h, channels).Resize(src, page.stride, resized.data(), tgt_w * channels);
+        });
+        report("resample/separable", separable);
+        spdlog::info("benchmark resample: {:.1f}x faster", baseline.mean_ms / separable.mean_ms);
+    }
+}
+
+// shrink a set of pages to thumbnail height with Lanczos alone and with the box pre-reduction
+void benchmark_thumbnail(const std::shared_ptr<lvgl_renderer>&)
+{
+    constexpr int iterations = 3;
+    constexpr int thumbnail_height = 128;
+    auto pages = benchmark_pages(10);
+    spdlog::info("benchmark thumbnail: {} pages to height {}", pages.size(), thumbnail_height);
+
+    auto direct = measure(iterations, [&] {
+        for (const auto& page : pages) {
+            int tgt_w = thumbnail_height * page.width / page.height;
+            Image thumbnail(tgt_w, thumbnail_height, page.format);
+            LanczosResampler(page.width, page.height, tgt_w, thumbnail_height, BytesPerPixel(page.format))
+                .Resize(page.Row(0), page.stride, thumbnail.Row(0), thumbnail.stride);
+        }
+    });
+    report("thumbnail/lanczos", direct);
+    auto pyramid = measure(iterations, [&] {
+        for (const auto& page : pages) {
+            Image thumbnail;
+            resize_image_lanczos(page, thumbnail_height, thumbnail);
+        }
+    });
+    report("thumbnail/box_lanczos", pyramid);
+    spdlog::info("benchmark thumbnail: {:.1f}x faster", direct.mean_ms / pyramid.mean_ms);
+}
+
+// read through a book at a steady pace, decoding each page on turn and with the prefetcher
+void benchmark_reader(const std::shared_ptr<lvgl_renderer>&)
+{
+    constexpr uint32_t max_turns = 20;
+    constexpr auto reading_time = std::chrono::milliseconds(300);
+    constexpr size_t budget_bytes = 64 * 1024 * 1024;
+    auto path = std::getenv(ENV_BENCHMARK_COMIC);
+    std::unique_ptr<ComicArchive> archive(path ? ComicArchive::Create(path) : nullptr);
+    if (!archive) {
+        spdlog::warn("benchmark reader: needs a comic in {}", ENV_BENCHMARK_COMIC);
+        return;
+    }
+    uint32_t turns = std::min(max_turns, archive->GetImageCount());
+
+    uint32_t page = 0;
+    auto direct = measure(turns, [&] {
+        Image image;
+        archive->GetImage(page++, SCREEN_HEIGHT, image, PixelFormat::L8);
+    });
+    report("reader/on_turn", direct);
+
+    std::string filename = archive->GetFilename();
+    PagePrefetcher prefetcher(std::move(archive), SCREEN_HEIGHT, PixelFormat::L8, budget_bytes);
+    page = 0;
+    auto prefetched = measure(turns, [&] {
+        prefetcher.GetPage(page++);
+        std::this_thread::sleep_for(reading_time);
+    });
+    // the measured span includes the reading time; only the page turn is of interest
+    auto reading_ms = std::chrono::duration<double, std::milli>(reading_time).count();
+    prefetched.mean_ms -= reading_ms;
+    prefetched.min_ms -= reading_ms;
+    prefetched.max_ms -= reading_ms;
+    report("reader/prefetched", prefetched);
+    spdlog::info("benchmark reader: {} hits, {} waits, {} misses over {} turns", stats::get("page_cache.hits").get(),
+                 stats::get("page_cache.waits").get(), stats::get("page_cache.misses").get(), turns);
+
+    // what reopening the book costs: the prefetcher left every page in the disk cache
+    struct stat st;
+    int64_t mtime = stat(filename.c_str(), &st) == 0 ? st.st_mtime : 0;
+    page = 0;
+    report("reader/disk_cache", measure(turns, [&] {
+        Image image;
+        PageDiskCache::GetInstance().Load({ filename, mtime, page++, SCREEN_HEIGHT, PixelFormat::L8 }, image);
+    }));
+}
+
+// read syscalls and page faults of the whole process so far
+struct io_counters {
+    uint64_t read_calls = 0;
+    uint64_t read_bytes = 0;
+    long major_faults = 0;
+    long minor_faults = 0;
+};
+
+io_counters read_io_counters()
+{
+    io_counters counters;
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    while (io >> key >> value) {
+        if (key == "syscr:") {
+            counters.read_calls = value;
+        } else if (key == "rchar:") {
+            counters.read_bytes = value;
+        }
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        counters.major_faults = usage.ru_majflt;
+        counters.minor_faults = usage.ru_minflt;
+    }
+    return counters;
+}
+
+// time one pass over the archive starting from a cold page cache; read returns the bytes extracted
+void measure_archive_read(const char* name, const char* path, const std::function<uint64_t()>& read)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    uint64_t bytes = 0;
+    auto before = read_io_counters();
+    auto t = measure(1, [&] { bytes = read(); });
+    auto after = read_io_counters();
+    spdlog::info("benchmark {}: {:.2f} ms, {:.1f} MB/s, {} read calls ({} KB), {} major / {} minor faults", name, t.mean_ms,
+                 bytes / t.mean_ms / 1000, after.read_calls - before.read_calls, (after.read_bytes - before.read_bytes) >> 10,
+                 after.major_faults - before.major_faults, after.minor_faults - before.minor_faults);
+}
+
+// extract every member with libarchive, reading from the file or from a mapping of it
+uint64_t read_with_libarchive(const char* path, const MappedFile* mapping)
+{
+    struct archive* a = archive_read_new();
+    archive_read_support_format_all(a);
+    archive_read_support_filter_all(a);
+    int result = mapping ? archive_read_open_memory(a, mapping->Data(), mapping->Size())
+                         : archive_read_open_filename(a, path, 10240);
+    uint64_t bytes = 0;
+    if (result == ARCHIVE_OK) {
+        std::vector<uint8_t> buffer(256 * 1024);
+        struct archive_entry* entry;
+        while (archive_read_next_header(a, &entry) == ARCHIVE_OK) {
+            ssize_t count;
+            while ((count = archive_read_data(a, buffer.data(), buffer.size())) > 0) {
+                bytes += count;
+            }
+        }
+    }
+    archive_read_free(a);
+    return bytes;
+}
+
+// every member of a book from a cold cache: libarchive on read() calls, libarchive on the
+// mapping, and ZipReader on the mapping, which decodes stored pages in place
+void benchmark_archive(const std::shared_ptr<lvgl_renderer>&)
+{
+    auto path = std::getenv(ENV_BENCHMARK_COMIC);
+    if (!path) {
+        spdlog::warn("benchmark archive: needs a comic in {}", ENV_BENCHMARK_COMIC);
+        return;
+    }
+
+    measure_archive_read("archive/libarchive_read", path, [path] { return read_with_libarchive(path, nullptr); });
+    measure_archive_read("archive/libarchive_mmap", path, [path] {
+        MappedFile file;
+        return file.Open(path) ? read_with_libarchive(path, &file) : 0;
+    });
+    measure_archive_read("archive/zip_mmap", path, [path] {
+        MappedFile file;
+        ZipReader zip;
+        uint64_t bytes = 0;
+        if (file.Open(path) && zip.Open(file.Data(), file.Size(), path)) {
+            PooledBuffer scratch;
+            for (const auto& entry : zip.Entries()) {
+                const uint8_t* data = ZipReader::CanRead(entry) && entry.size > 0 ? zip.Read(entry, scratch) : nullptr;
+                bytes += data ? entry.size : 0;
+            }
+        }
+        return bytes;
+    });
+}
+
+const std::map<std::string, std::function<void(const std::shared_ptr<lvgl_renderer>&)>> suites_by_name = {
+    { "lvgl", benchmark_lvgl },
+    { "dither", benchmark_dither },
+    { "resample", benchmark_resample },
+    { "thumbnail", benchmark_thumbnail },
+    { "reader", benchmark_reader },
+    { "archive", benchmark_archive },
+};
+
+}
+
+void run_benchmarks(const std::string& suites, const std::shared_ptr<lvgl_renderer>& renderer)
+{
+    std::istringstream stream(suites);
+    std::string suite;
+    while (std::getline(stream, suite, ',')) {
+        auto it = suites_by_name.find(suite);
+        if (it == suites_by_name.end()) {
+            spdlog::warn("Unknown benchmark suite: {}", suite);
+            continue;
+        }
+
+        spdlog::info("Running benchmark suite {}", suite);
+        it->second(renderer);
+    }
+}
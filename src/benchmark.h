@@ -0,0 +1,13 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "gui/lvgl_renderer.h"
+
+#include <memory>
+#include <string>
+
+// Opt-in benchmarks that run inside the compositor on the device.
+// BIFROST_BENCHMARK holds a comma separated list of suites, e.g. "lvgl".
+void run_benchmarks(const std::string& suites, const std::shared_ptr<lvgl_renderer>& renderer);
+
+#endif // BENCHMARK_H
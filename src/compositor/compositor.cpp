@@ -4,6 +4,10 @@
 #include "../gui/boot_screen.h"
 #include "../gui/ChooseFile_screen.h"
 #include "../BookConfig.h"
+#include "../benchmark.h"
+#include "../utils/stats.h"
+#include "../utils/trace.h"
+#include <future>
 #include <utility>
 
 compositor::compositor(display_config cfg)
@@ -13,7 +17,13 @@ compositor::compositor(display_config cfg)
           cfg.fb,
           [this](auto &&PH1, auto &&PH2) {
               request_refresh(std::forward<decltype(PH1)>(PH1), std::forward<decltype(PH2)>(PH2));
-          })) {
+          }))
+      , ghosting(cfg.fb->width(), cfg.fb->height()) {
+    // before lvgl starts so that its profiler events are captured from the first frame
+    if (auto trace_path = std::getenv(ENV_TRACE)) {
+        trace_start(trace_path);
+    }
+
     cfg.fb->fill(QColor(255, 255, 255));
     renderer->initialize();
 }
@@ -22,10 +32,14 @@ void compositor::start() {
     spdlog::info("Starting bifrost compositor");
     running = true;
 
-    render_thread = std::thread([this]() {
+    std::promise<void> bound;
+    render_thread = std::thread([this, &bound]() {
+        g_ui_tasks.bind_to_current_thread();
+        bound.set_value();
         int freq = 1000000 / 85;
         long last_tick = 0;
         while (running) {
+            BIFROST_TRACE_BEGIN("frame");
             render_clients();
             renderer->tick();
 
@@ -34,21 +48,36 @@ void compositor::start() {
             }
             canvas_buf_deletion_queue.clear();
 
-            for (const auto &[req_region, req_type]: pending_refresh_requests) {
+            std::vector<std::pair<rect, refresh_type>> refresh_requests;
+            {
+                std::lock_guard lock(refresh_mutex);
+                refresh_requests.swap(pending_refresh_requests);
+            }
+            auto refresh_time = ghosting_tracker::clock::now();
+            for (const auto &[req_region, req_type]: refresh_requests) {
                 refresh(req_region.p1, req_region.p2, req_type);
+                ghosting.record(req_region, req_type, refresh_time);
+            }
+
+            // once the screen has settled, flash only the tiles that took too many partial updates
+            for (const auto &area: ghosting.collect_cleanup(refresh_time)) {
+                refresh(area.p1, area.p2, FULL);
+                ghosting.record(area, FULL, refresh_time);
             }
-            pending_refresh_requests.clear();
+            BIFROST_TRACE_END("frame");
             long now = std::chrono::duration_cast<std::chrono::milliseconds>(
                 std::chrono::system_clock::now().time_since_epoch()).count();
             long sleep_time = freq - (now - last_tick);
             if (sleep_time > 0) {
-                std::this_thread::sleep_for(std::chrono::microseconds(sleep_time));
+                // queued UI work (e.g. new input samples) cuts the sleep short
+                g_ui_tasks.wait_for_tasks(std::chrono::microseconds(sleep_time));
             }
             last_tick = now;
 
             if (std::chrono::duration_cast<std::chrono::seconds>(
                 std::chrono::system_clock::now() - last_fps_update).count() >= 10) {
                 spdlog::info("FPS: {}", fps);
+                stats::log();
                 fps = 0;
                 last_fps_update = std::chrono::system_clock::now();
             } else {
@@ -83,6 +112,13 @@ void compositor::start() {
 
     */
 
+    // this thread owned lvgl for initialize(); from here on its LVGL work must go through the queue
+    bound.get_future().wait();
+
+    if (auto suites = std::getenv(ENV_BENCHMARK)) {
+        run_benchmarks(suites, renderer);
+    }
+
    {
        spdlog::debug("Starting App");
        //read configuration
@@ -99,9 +135,11 @@ void compositor::start() {
 
     listener_thread = std::thread(&compositor::listener, this);
     render_thread.join();
+    trace_stop();
 }
 
 void compositor::request_refresh(rect update_region, refresh_type type) {
+    std::lock_guard lock(refresh_mutex);
     if (pending_refresh_requests.empty()) {
         pending_refresh_requests.emplace_back(update_region, type);
     } else {
@@ -117,6 +155,7 @@ void compositor::request_refresh(rect update_region, refresh_type type) {
 }
 
 void compositor::render_clients() {
+    TRACE_SCOPE("render_clients");
     std::lock_guard lock(client_mutex);
 
     if (system_ui_inst && system_ui_inst->requested_application_exit()) {
@@ -128,6 +167,7 @@ void compositor::render_clients() {
     clients.erase(std::remove_if(clients.begin(), clients.end(), [this](const auto &client) {
         if (client->state == compositor_client::client_state::DISCONNECTED) {
             spdlog::info("Client {} has disconnected", client->application_name);
+            client->destroy_lvgl_canvas();
             canvas_buf_deletion_queue.push_back(client->lvgl_canvas_buffer);
             return true;
         }
@@ -182,6 +222,7 @@ void compositor::listener() {
 }
 
 void compositor::refresh(const point p1, const point p2, const refresh_type type) const {
+    TRACE_SCOPE("refresh");
     spdlog::debug("Refreshing area: {}x{}-{}x{} with type {}", p1.x, p1.y, p2.x, p2.y, static_cast<int>(type));
     switch (type) {
         case MONOCHROME:
@@ -5,6 +5,7 @@
 #include "../utils/shm_channel.h"
 #include "../utils/unix_socket.h"
 #include "compositor_client.h"
+#include "ghosting_tracker.h"
 #include "../gui/system_ui.h"
 #include <memory>
 #include <thread>
@@ -36,7 +37,10 @@ private:
     std::vector<std::shared_ptr<compositor_client>> clients;
     std::shared_ptr<compositor_client> active_client;
 
+    // filled by the render thread and by the lvgl flush thread
+    std::mutex refresh_mutex;
     std::vector<std::pair<rect, refresh_type>> pending_refresh_requests;
+    ghosting_tracker ghosting;
 
     int fps = 0;
     std::chrono::time_point<std::chrono::system_clock> last_fps_update;
@@ -4,6 +4,9 @@
 #include <vector>
 
 #include "../constants.h"
+#include "../utils/trace.h"
+#include "../utils/ui_task_queue.h"
+#include "../utils/waveform_classifier.h"
 #include "packets/begin_session_request.h"
 #include "packets/begin_session_response.h"
 #include "packets/packet.h"
@@ -18,17 +21,36 @@
 
 compositor_client::compositor_client(std::unique_ptr<unix_socket::connection> conn, const compositor_client_config cfg)
     : cfg(cfg), conn(std::move(conn)), running(false), aligned_image_size(0) {
+    if (std::getenv(ENV_DITHER)) {
+        dither = std::make_unique<ditherer>(cfg.swapchain_extent.x);
+    }
 }
 
 void compositor_client::create_lvgl_canvas() {
-    std::lock_guard lock(g_lvgl_mutex);
-    lvgl_canvas = lv_canvas_create(lv_screen_active());
-    lvgl_canvas_buffer = new uint8_t[cfg.swapchain_extent.x * cfg.swapchain_extent.y * 4];
-    lv_canvas_set_buffer(lvgl_canvas, lvgl_canvas_buffer, cfg.swapchain_extent.x, cfg.swapchain_extent.y,
-                         LV_COLOR_FORMAT_ARGB8888);
-    lv_obj_set_pos(lvgl_canvas, cfg.pos.x, cfg.pos.y);
-
-    spdlog::debug("Created LVGL canvas at ({}, {})", cfg.pos.x, cfg.pos.y);
+    // don't wait for the render thread here: it may be joining this client's thread
+    g_ui_tasks.dispatch([weak = weak_from_this()] {
+        auto self = weak.lock();
+        if (!self || self->state == client_state::DISCONNECTED) {
+            return;
+        }
+
+        auto &cfg = self->cfg;
+        self->lvgl_canvas = lv_canvas_create(lv_screen_active());
+        self->lvgl_canvas_buffer = new uint8_t[cfg.swapchain_extent.x * cfg.swapchain_extent.y * 4];
+        lv_canvas_set_buffer(self->lvgl_canvas, self->lvgl_canvas_buffer, cfg.swapchain_extent.x,
+                             cfg.swapchain_extent.y, LV_COLOR_FORMAT_ARGB8888);
+        lv_obj_set_pos(self->lvgl_canvas, cfg.pos.x, cfg.pos.y);
+
+        spdlog::debug("Created LVGL canvas at ({}, {})", cfg.pos.x, cfg.pos.y);
+    });
+}
+
+// called by the compositor on the render thread once the client has disconnected
+void compositor_client::destroy_lvgl_canvas() {
+    if (lvgl_canvas) {
+        lv_obj_delete(lvgl_canvas);
+        lvgl_canvas = nullptr;
+    }
 }
 
 void compositor_client::start() {
@@ -80,11 +102,6 @@ void compositor_client::stop() {
 
     client_thread.join();
 
-    {
-        std::lock_guard lock(g_lvgl_mutex);
-        lv_obj_delete(lvgl_canvas);
-    }
-
     state = client_state::DISCONNECTED;
 
     spdlog::debug("Stopped client {}", application_name);
@@ -115,7 +132,7 @@ void compositor_client::handle_packet(const std::shared_ptr<packet> &packet) {
     if (auto req = std::dynamic_pointer_cast<begin_session_request>(packet)) {
         spdlog::info("Application {} requested session creation", req->application_name);
         if (state != client_state::CONNECTED) {
-            spdlog::warn("Invalid client state: {}", static_cast<int>(state));
+            spdlog::warn("Invalid client state: {}", static_cast<int>(state.load()));
             stop();
             return;
         }
@@ -213,7 +230,11 @@ void compositor_client::release_swapchain_image(uint32_t frame_id) {
 }
 
 std::optional<std::pair<rect, refresh_type>> compositor_client::blit_to_canvas() {
-    std::lock_guard lock(g_lvgl_mutex);
+    TRACE_SCOPE("blit_to_canvas");
+    // the canvas is created asynchronously; keep frames queued until it exists
+    if (!lvgl_canvas) {
+        return std::nullopt;
+    }
     auto swapchain_image = get_swapchain_image();
     if (!swapchain_image) {
         return std::nullopt;
@@ -243,7 +264,25 @@ std::optional<std::pair<rect, refresh_type>> compositor_client::blit_to_canvas()
     lv_draw_image(&layer, &dsc, &coords);
     lv_canvas_finish_layer(lvgl_canvas, &layer);
 
+    auto type = submit_frame.preferred_refresh_type;
+    auto pixels = reinterpret_cast<const uint8_t *>(image_data);
+    if (dither) {
+        // dither the canvas copy: the client may keep drawing incrementally into its own buffer
+        rect canvas_area = {{0, 0}, {cfg.swapchain_extent.x - 1, cfg.swapchain_extent.y - 1}};
+        dither->set_mode(dither_mode_for(type));
+        dither->dither_region(lvgl_canvas_buffer, cfg.swapchain_extent.x * 4, update_region.intersection(canvas_area));
+        pixels = lvgl_canvas_buffer;
+    }
+
+    if (type == AUTO) {
+        auto histogram = histogram_argb8888(pixels, cfg.swapchain_extent.x * 4, cfg.swapchain_extent, update_region);
+        type = fastest_refresh_type(histogram.content());
+        spdlog::debug("Classified frame from {}: {} b/w, {} gray, {} palette, {} color pixels -> refresh type {}",
+                      application_name, histogram.black_white, histogram.grayscale, histogram.palette, histogram.color,
+                      static_cast<int>(type));
+    }
+
     release_swapchain_image(frame_id);
 
-    return std::make_pair(update_region, submit_frame.preferred_refresh_type);
+    return std::make_pair(update_region, type);
 }
@@ -2,6 +2,7 @@
 #ifndef COMPOSITOR_CLIENT_H
 #define COMPOSITOR_CLIENT_H
 #include "../utils/data_structs.h"
+#include "../utils/dither.h"
 #include "../utils/shm_channel.h"
 #include "../utils/unix_socket.h"
 #include "packets/begin_session_response.h"
@@ -13,9 +14,10 @@
 #include <mutex>
 #include <queue>
 #include <optional>
+#include <memory>
 #include <src/misc/lv_types.h>
 
-class compositor_client {
+class compositor_client : public std::enable_shared_from_this<compositor_client> {
 public:
     struct compositor_client_config {
         uint32_t id;
@@ -38,12 +40,13 @@ public:
     std::optional<std::tuple<uint32_t, submit_frame_packet, rect, uint64_t>> get_swapchain_image();
     void release_swapchain_image(uint32_t frame_id);
     std::optional<std::pair<rect, refresh_type>> blit_to_canvas();
+    void destroy_lvgl_canvas();
 
     std::string application_name = "Untitled";
     std::string window_title = "Untitled";
     bool prefer_full_screen = false;
-    client_state state = client_state::CONNECTED;
-    uint8_t *lvgl_canvas_buffer;
+    std::atomic<client_state> state = client_state::CONNECTED;
+    uint8_t *lvgl_canvas_buffer = nullptr;
 private:
     void handle_packet(const std::shared_ptr<packet>& packet);
     void send_packet(const std::shared_ptr<packet>& resp);
@@ -69,6 +72,8 @@ private:
     std::mutex packet_write_mutex;
 
     lv_obj_t* lvgl_canvas = nullptr;
+    // set when BIFROST_DITHER is; quantizes frames on the canvas copy
+    std::unique_ptr<ditherer> dither;
 };
 
 #endif // COMPOSITOR_CLIENT_H
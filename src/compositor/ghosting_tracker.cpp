@@ -0,0 +1,64 @@
+#include "ghosting_tracker.h"
+
+#include "../utils/stats.h"
+
+ghosting_tracker::ghosting_tracker(uint32_t width, uint32_t height)
+    : grid(width, height)
+    , partial_refreshes(grid.columns() * grid.rows())
+{
+}
+
+void ghosting_tracker::record(rect area, refresh_type type, clock::time_point now)
+{
+    last_refresh = now;
+
+    uint32_t last_column = std::min(area.p2.x / damage_grid::TILE_SIZE, grid.columns() - 1);
+    uint32_t last_row = std::min(area.p2.y / damage_grid::TILE_SIZE, grid.rows() - 1);
+    for (uint32_t row = area.p1.y / damage_grid::TILE_SIZE; row <= last_row; row++) {
+        for (uint32_t column = area.p1.x / damage_grid::TILE_SIZE; column <= last_column; column++) {
+            auto& count = partial_refreshes[row * grid.columns() + column];
+            if (type == FULL) {
+                // only a tile the refresh covers entirely is clean again
+                auto bounds = grid.tile_bounds(column, row);
+                bool covered = area.p1.x <= bounds.p1.x && area.p1.y <= bounds.p1.y && area.p2.x >= bounds.p2.x
+                    && area.p2.y >= bounds.p2.y;
+                if (covered) {
+                    tiles_over_budget -= count >= BUDGET;
+                    count = 0;
+                }
+            } else if (count < UINT16_MAX) {
+                count++;
+                tiles_over_budget += count == BUDGET;
+            }
+        }
+    }
+}
+
+std::vector<rect> ghosting_tracker::collect_cleanup(clock::time_point now)
+{
+    if (tiles_over_budget == 0 || now - last_refresh < IDLE_TIME) {
+        return {};
+    }
+
+    static auto& cleanup_tiles = stats::get("ghosting.cleanup_tiles");
+    static auto& cleanup_refreshes = stats::get("ghosting.cleanup_refreshes");
+
+    for (uint32_t row = 0; row < grid.rows(); row++) {
+        for (uint32_t column = 0; column < grid.columns(); column++) {
+            auto& count = partial_refreshes[row * grid.columns() + column];
+            if (count >= BUDGET) {
+                grid.mark_tile(column, row, pixel_content::BLACK_WHITE);
+                count = 0;
+                cleanup_tiles.add(1);
+            }
+        }
+    }
+    tiles_over_budget = 0;
+
+    std::vector<rect> areas;
+    for (const auto& region : grid.collect()) {
+        areas.push_back(region.area);
+    }
+    cleanup_refreshes.add(areas.size());
+    return areas;
+}
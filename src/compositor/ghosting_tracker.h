@@ -0,0 +1,39 @@
+#ifndef GHOSTING_TRACKER_H
+#define GHOSTING_TRACKER_H
+
+#include "../utils/damage_grid.h"
+
+#include <bifrost/global_constants.h>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Counts the partial (non-flashing) refreshes each tile received since its
+// last full refresh. Tiles over budget get a regional FULL refresh once the
+// screen has been idle for a while, instead of flashing the whole screen.
+class ghosting_tracker {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // partial refreshes a tile may take before it is scheduled for cleanup
+    static constexpr uint16_t BUDGET = 16;
+    // how long nothing may refresh before cleanup refreshes are issued
+    static constexpr auto IDLE_TIME = std::chrono::milliseconds(1500);
+
+    ghosting_tracker(uint32_t width, uint32_t height);
+
+    // Account for a refresh that was sent to the panel.
+    void record(rect area, refresh_type type, clock::time_point now);
+
+    // Merged regions of the tiles over budget, if the screen has been idle long enough.
+    // Their counters are reset, so the caller must issue FULL refreshes for them.
+    std::vector<rect> collect_cleanup(clock::time_point now);
+
+private:
+    damage_grid grid;
+    std::vector<uint16_t> partial_refreshes;
+    uint32_t tiles_over_budget = 0;
+    clock::time_point last_refresh;
+};
+
+#endif // GHOSTING_TRACKER_H
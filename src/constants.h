@@ -8,8 +8,24 @@
 constexpr auto SCREEN_WIDTH = 1620;
 constexpr auto SCREEN_HEIGHT = 2160;
 
-constexpr auto ENV_DEBUG = "BIFROST_DEBUG";
+// one TGA per book in older versions, now the directory of the packed thumbnail store
+constexpr auto THUMBNAIL_DIR = "/home/root/thumb/";
+constexpr auto THUMBNAIL_STORE_FILE = "/home/root/thumb/thumbnails.bin";
+
+// pages already scaled to the screen, kept across runs
+constexpr auto PAGE_CACHE_DIR = "/home/root/page_cache/";
 
-inline std::mutex g_lvgl_mutex;
+// page lists of archives that can only be read front to back, kept across runs
+constexpr auto ARCHIVE_INDEX_DIR = "/home/root/archive_index/";
+
+constexpr auto ENV_DEBUG = "BIFROST_DEBUG";
+constexpr auto ENV_RENDER_IN_PLACE = "BIFROST_RENDER_IN_PLACE";
+constexpr auto ENV_BENCHMARK = "BIFROST_BENCHMARK";
+// comic archive whose first pages feed the image benchmarks
+constexpr auto ENV_BENCHMARK_COMIC = "BIFROST_BENCHMARK_COMIC";
+constexpr auto ENV_IMAGE_CACHE_MB = "BIFROST_IMAGE_CACHE_MB";
+constexpr auto ENV_PAGE_CACHE_DISK_MB = "BIFROST_PAGE_CACHE_DISK_MB";
+constexpr auto ENV_DITHER = "BIFROST_DITHER";
+constexpr auto ENV_TRACE = "BIFROST_TRACE";
 
 #endif // CONSTANTS_H
\ No newline at end of file
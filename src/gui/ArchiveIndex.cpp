@@ -0,0 +1,146 @@
+#include "ArchiveIndex.h"
+#include "../constants.h"
+#include "../utils/stats.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t INDEX_MAGIC = 0x58444941; // "AIDX"
+constexpr uint32_t INDEX_VERSION = 1;
+
+// followed by path_size bytes of archive path, then count entries: uint64 index, uint32 name size, name
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    int64_t mtime;
+    uint32_t path_size;
+    uint32_t count;
+};
+
+// FNV-1a of the path; the header in the file tells collisions apart
+std::string FilePath(const std::string& path)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : path) {
+        hash = (hash ^ c) * 0x100000001b3ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.index", static_cast<unsigned long long>(hash));
+    return std::string(ARCHIVE_INDEX_DIR) + name;
+}
+
+template <typename T>
+void Append(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// reads values from the file contents, failing for good at the first one that isn't there
+class Parser {
+public:
+    explicit Parser(const std::string& data) : data(data) {}
+
+    template <typename T>
+    bool Read(T& value)
+    {
+        if (data.size() - offset < sizeof(value)) {
+            return false;
+        }
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    }
+
+    bool Read(std::string& value, size_t size)
+    {
+        if (data.size() - offset < size) {
+            return false;
+        }
+        value.assign(data, offset, size);
+        offset += size;
+        return true;
+    }
+
+    bool AtEnd() const { return offset == data.size(); }
+
+private:
+    const std::string& data;
+    size_t offset = 0;
+};
+
+}
+
+bool ArchiveIndex::Load(const Key& key, std::vector<Entry>& entries)
+{
+    static auto& hits = stats::get("archive_index.hits");
+    static auto& misses = stats::get("archive_index.misses");
+
+    std::ifstream file(FilePath(key.path), std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Parser parser(data);
+
+    IndexHeader header;
+    std::string path;
+    bool valid = parser.Read(header) && header.magic == INDEX_MAGIC && header.version == INDEX_VERSION
+        && header.size == key.size && header.mtime == key.mtime
+        && parser.Read(path, header.path_size) && path == key.path;
+
+    std::vector<Entry> loaded;
+    for (uint32_t i = 0; valid && i < header.count; i++) {
+        uint64_t index;
+        uint32_t name_size;
+        std::string name;
+        valid = parser.Read(index) && parser.Read(name_size) && parser.Read(name, name_size);
+        loaded.push_back({ std::move(name), static_cast<size_t>(index) });
+    }
+    if (!valid || !parser.AtEnd()) {
+        misses.add(1);
+        return false;
+    }
+    hits.add(1);
+    entries = std::move(loaded);
+    spdlog::debug("{}: {} pages from the archive index", key.path, entries.size());
+    return true;
+}
+
+void ArchiveIndex::Store(const Key& key, const std::vector<Entry>& entries)
+{
+    IndexHeader header {};
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.size = key.size;
+    header.mtime = key.mtime;
+    header.path_size = key.path.size();
+    header.count = entries.size();
+
+    std::string data;
+    Append(data, header);
+    data += key.path;
+    for (const auto& entry : entries) {
+        Append(data, static_cast<uint64_t>(entry.index));
+        Append(data, static_cast<uint32_t>(entry.name.size()));
+        data += entry.name;
+    }
+
+    if (mkdir(ARCHIVE_INDEX_DIR, 0755) != 0 && errno != EEXIST) {
+        spdlog::warn("Can't create archive index {}: {}", ARCHIVE_INDEX_DIR, strerror(errno));
+        return;
+    }
+    // written under a private name and renamed, so a reader never sees half an index
+    std::string path = FilePath(key.path);
+    std::string temp_path = path + ".tmp" + std::to_string(getpid());
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    file.close();
+    if (!file || rename(temp_path.c_str(), path.c_str()) != 0) {
+        spdlog::warn("Can't write archive index {}: {}", path, strerror(errno));
+        unlink(temp_path.c_str());
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef ARCHIVE_INDEX_H
+#define ARCHIVE_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sorted page lists of archives read through libarchive, one small file each under
+// ARCHIVE_INDEX_DIR. Listing such an archive means walking every header, which for a
+// solid RAR decompresses the whole file; with the index, reopening a book doesn't.
+// Entries are keyed by path, size and mtime so that a replaced file is scanned again.
+class ArchiveIndex {
+public:
+    struct Key {
+        std::string path;
+        uint64_t size;
+        int64_t mtime;
+    };
+
+    struct Entry {
+        std::string name; // lower case
+        size_t index;     // position among the archive's headers
+    };
+
+    // Fill entries from the index of key; false if there is none or it is stale
+    static bool Load(const Key& key, std::vector<Entry>& entries);
+    static void Store(const Key& key, const std::vector<Entry>& entries);
+};
+
+#endif // ARCHIVE_INDEX_H
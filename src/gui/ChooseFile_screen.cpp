@@ -7,6 +7,9 @@
 #include "../constants.h"
 #include "../BookConfig.h"
 #include "ImageIo.h"
+#include "ImageCache.h"
+#include "ThumbnailStore.h"
+#include <sys/stat.h>
 #include <fstream>
 #include <iostream>
 #include <cstring>
@@ -15,11 +18,14 @@ LV_IMG_DECLARE(brokenfile);
 
 const char* ChooseFile_screen::supported_extensions[] = { ".cbr", ".cbz", NULL };
 
+// lvgl's native format, so thumbnails are drawn without a conversion; gray covers stay L8
+constexpr PixelFormat THUMBNAIL_FORMAT = PixelFormat::ARGB8888;
+
 void ChooseFile_screen::start(const char* folder) {
     spdlog::debug("starting ChooseFile_screen new");
     instance = shared_from_this();
-    lvgl_renderer_inst->set_global_refresh_hint(COLOR_FAST);
-    create_file_browser(lv_layer_top(), folder, supported_extensions);
+    lvgl_renderer_inst->set_global_refresh_hint(AUTO);
+    g_ui_tasks.run([this, folder] { create_file_browser(lv_layer_top(), folder, supported_extensions); });
     spdlog::debug("refresh");
     //lvgl_renderer_inst->refresh({ 0, 0 }, { SCREEN_WIDTH, SCREEN_HEIGHT }, FULL);
     // wait for the user to select an option
@@ -31,10 +37,11 @@ void ChooseFile_screen::start(const char* folder) {
 }
 
 ChooseFile_screen::~ChooseFile_screen() {
-    std::lock_guard lock(g_lvgl_mutex);
-    for (auto obj : deletion_queue) {
-        lv_obj_delete(obj);
-    }
+    g_ui_tasks.run([this] {
+        for (auto obj : deletion_queue) {
+            lv_obj_delete(obj);
+        }
+    });
 }
 
 //event lambda wrapper
@@ -43,7 +50,6 @@ ChooseFile_screen::~ChooseFile_screen() {
 // Create the file browser UI using lv_display_t
 void ChooseFile_screen::create_file_browser(lv_obj_t* screen, const char* start_folder, const char** extensions) 
 {
-    std::lock_guard lock(g_lvgl_mutex);
     // Copy the start folder to the current folder global variable
     strncpy(current_folder, start_folder, sizeof(current_folder) - 1);
 
@@ -67,7 +73,6 @@ void ChooseFile_screen::create_file_browser(lv_obj_t* screen, const char* start_
     // Create the file list below the path label
     lv_obj_t* file_list = lv_list_create(container);
     lv_obj_set_size(file_list, lv_pct(100), lv_pct(80));
-    lv_obj_add_event_cb(file_list, EVENT(scroll_event_cb), LV_EVENT_ALL, NULL);
     deletion_queue.push_back(file_list);
 
 
@@ -128,6 +133,10 @@ void ChooseFile_screen::list_files(const char* folder_path, const char** extensi
     // Clear the current list before populating it
     lv_obj_clean(list);
 
+    // pick up the thumbnails generated on earlier visits
+    auto& thumbnails = ThumbnailStore::GetInstance();
+    thumbnails.Refresh();
+
 
     // Add "Parent Directory" button to go back
     if (strcmp(folder_path, "/") != 0) {  // If not in root
@@ -173,35 +182,41 @@ void ChooseFile_screen::list_files(const char* folder_path, const char** extensi
             //get info
             spdlog::debug("fetching bookinfo for  file: {}\n", file);
             BookInfo bookInfo = BookConfig::GetInstance().GetBookInfo(file);
-            Image image;
-            bool loaded = false;
-            if (bookInfo.pageCount == 0 || bookInfo.thumbnail == "")
-            {
-                spdlog::debug("creating bookin for  file: {}", file);
-                //build info
-                std::string fullfilename = std::string(current_folder) + file;
-                ComicArchive* archive = ComicArchive::Create(fullfilename.c_str());
-                if (archive)
+            std::string fullfilename = std::string(current_folder) + file;
+            struct stat file_stat;
+            int64_t mtime = stat(fullfilename.c_str(), &file_stat) == 0 ? file_stat.st_mtime : 0;
+            auto load_thumbnail = [&](Image& image) {
+                bool loaded = false;
+                if (bookInfo.pageCount > 0 && bookInfo.thumbnail != "")
+                {
+                    // one TGA per book, written by older versions
+                    spdlog::debug("fetching bookin for  file: {} : \n{}\n", file, bookInfo.thumbnail);
+                    loaded = load_image_as_tga(image, (std::string(THUMBNAIL_DIR) + bookInfo.thumbnail).c_str(), THUMBNAIL_FORMAT);
+                }
+                if (!loaded)
                 {
-                    bookInfo.pageCount = archive->GetImageCount();
-                    bookInfo.currentPage = 0;
-                    loaded = archive->GetImage(0, 128, image);
-                    if (loaded)
+                    spdlog::debug("creating bookin for  file: {}", file);
+                    //build info
+                    ComicArchive* archive = ComicArchive::Create(fullfilename.c_str());
+                    if (archive)
                     {
-                        bookInfo.thumbnail = file + ".thumb.tga";
-                        save_image_as_tga(image, (std::string("/home/root/thumb/") + bookInfo.thumbnail).c_str());
-                        BookConfig::GetInstance().SetBookInfo(bookInfo);
+                        bookInfo.pageCount = archive->GetImageCount();
+                        bookInfo.currentPage = 0;
+                        loaded = archive->GetImage(0, 128, image, THUMBNAIL_FORMAT);
+                        if (loaded)
+                        {
+                            bookInfo.thumbnail = "";
+                            BookConfig::GetInstance().SetBookInfo(bookInfo);
+                        }
+                        delete archive;
                     }
-                    delete archive;
                 }
-            }
-            else
-            {
-                spdlog::debug("fetching bookin for  file: {} : \n{}\n", file, bookInfo.thumbnail);
-                loaded = load_image_as_tga(image, (std::string("/home/root/thumb/") + bookInfo.thumbnail).c_str());
-            }
-
-
+                if (loaded)
+                {
+                    thumbnails.Add(fullfilename, mtime, image);
+                }
+                return loaded;
+            };
 
             // Create a list button for each supported file with a custom icon
             lv_obj_t* btn = lv_list_add_btn(list, NULL, NULL);  // Leave text as NULL, since we handle it separately
@@ -217,29 +232,16 @@ void ChooseFile_screen::list_files(const char* folder_path, const char** extensi
 
 
 
-            //add icon: image or warning
+            //add icon: stored thumbnail, freshly generated one or warning
+            lv_obj_t* icon = lv_img_create(row);
+            const lv_image_dsc_t* stored = bookInfo.pageCount > 0 ? thumbnails.Find(fullfilename, mtime) : nullptr;
+            bool loaded = stored != nullptr;
             if (loaded)
-            {
-                lv_img_dsc_t* img_dsc = nullptr;
-                spdlog::debug("Creating LVGL image descriptor");
-                img_dsc = new lv_img_dsc_t;
-                img_dsc->header.magic = LV_IMAGE_HEADER_MAGIC;
-                img_dsc->header.flags = LV_IMAGE_FLAGS_ALLOCATED;
-                img_dsc->header.w = image.width;
-                img_dsc->header.h = image.height;
-                img_dsc->header.stride = image.width * (image.is_rgb ? 3 : 1);
-                img_dsc->header.cf = image.is_rgb ? LV_COLOR_FORMAT_RGB888 : LV_COLOR_FORMAT_L8;
-                img_dsc->data = (unsigned char*)image.data; image.data = nullptr; // Transfer ownership
-                img_dsc->data_size = image.width * image.height * (image.is_rgb ? 3 : 1);
-                lv_obj_t* icon = lv_img_create(row);
-                lv_img_set_src(icon, img_dsc);
-                spdlog::debug("LVGL image descriptor created: width={}, height={}, color format={}", (uint32_t)img_dsc->header.w, (uint32_t)img_dsc->header.h, image.is_rgb);
-            }
+                lv_image_set_src(icon, stored);
             else
-            {                
-                lv_obj_t* icon = lv_img_create(row);
+                loaded = ImageCache::GetInstance().SetImageSource(icon, fullfilename + "#thumbnail@" + std::to_string(mtime), load_thumbnail);
+            if (!loaded)
                 lv_image_set_src(icon, &brokenfile);
-            }
 
             //second column: create horizontal container
             lv_obj_t* secondColumn = lv_obj_create(row);
@@ -256,7 +258,7 @@ void ChooseFile_screen::list_files(const char* folder_path, const char** extensi
 
             // Add comment
             std::string commentStr = "UNREADABLE FILE";
-            if (loaded) commentStr =  std::to_string(int(100 * bookInfo.currentPage / bookInfo.pageCount)) + "% - page " + std::to_string(bookInfo.currentPage)+ "/" + std::to_string(bookInfo.pageCount);
+            if (loaded && bookInfo.pageCount > 0) commentStr =  std::to_string(int(100 * bookInfo.currentPage / bookInfo.pageCount)) + "% - page " + std::to_string(bookInfo.currentPage)+ "/" + std::to_string(bookInfo.pageCount);
             lv_obj_t* comment = lv_label_create(secondColumn);
             lv_label_set_text(comment, commentStr.c_str());
             lv_obj_set_style_text_font(comment, &lv_font_montserrat_20, 0);
@@ -266,6 +268,8 @@ void ChooseFile_screen::list_files(const char* folder_path, const char** extensi
                 lv_obj_add_event_cb(label, EVENT(file_selected_cb), LV_EVENT_CLICKED, NULL);
         }
     }
+    // decoding the missing thumbnails left full-size page buffers in the pool; the browser won't reuse them
+    ImagePool::Trim();
 }
 
 // Callback for folder selection (navigating into directories)
@@ -292,10 +296,8 @@ void ChooseFile_screen::folder_selected_cb(lv_event_t* e) {
     }
     spdlog::debug("currentfolder: {}.\n", current_folder);
 
-    // Re-list the files in the new folder
+    // Re-list the files in the new folder (event callbacks already run on the lvgl thread)
     {
-        //don't lock in lvgl thread...
-        //std::lock_guard lock(g_lvgl_mutex);
         spdlog::debug("listing\n");
         lv_obj_t* list = lv_obj_get_parent(btn);
         list_files(current_folder, supported_extensions, list);
@@ -331,18 +333,6 @@ void ChooseFile_screen::abort_cb(lv_event_t* e) {
 }
 
 
-// Callback function for scrolling
-void ChooseFile_screen::scroll_event_cb(lv_event_t* e)
-{
-    lv_obj_t* obj = (lv_obj_t*)lv_event_get_target(e);
-    lv_event_code_t code = lv_event_get_code(e);
-    if (code == LV_EVENT_RELEASED)
-    {
-        spdlog::debug("End Scrolling");
-        lvgl_renderer_inst->request_full_refresh();
-    }
-}
-
 // Update the path label with the current folder path
 void ChooseFile_screen::update_path_label() {
     lv_label_set_text(path_label, current_folder);
@@ -36,7 +36,6 @@ private:
     void folder_selected_cb(lv_event_t* e);
     void file_selected_cb(lv_event_t* e);
     void abort_cb(lv_event_t* e);
-    void scroll_event_cb(lv_event_t* e);
     void update_path_label();
 };
 
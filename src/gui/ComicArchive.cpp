@@ -1,173 +1,276 @@
 #include "ComicArchive.h"
 #include <archive.h>
 #include <archive_entry.h>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <cstring>
 #include <spdlog/spdlog.h>
+#include <sys/stat.h>
 #include "lvgl.h"
+#include "ArchiveIndex.h"
 #include "ImageIo.h"
+#include "MappedFile.h"
+#include "ZipReader.h"
 
-// Concrete implementation of ComicArchive
+namespace {
+
+// a compressed page file; sizes past this come from a corrupt or crafted header
+constexpr int64_t MAX_PAGE_FILE_SIZE = 128 * 1024 * 1024;
+
+}
+
+// Concrete implementation of ComicArchive. The file is mapped once: ZIP files (CBZ) are read
+// through their central directory, stored pages decoded in place; everything else goes through
+// libarchive over the same mapping, whose handle stays open so that reading pages in order never
+// rescans the archive. Their page lists are kept in ArchiveIndex across opens.
 class ComicArchiveImpl : public ComicArchive {
 public:
     ComicArchiveImpl(const char* archive_name);
     ~ComicArchiveImpl() override;
 
+    // Build the page index; false if the file isn't an archive
+    bool Open();
+
+    const std::string& GetFilename() const override { return archive_name; }
     uint32_t GetImageCount() override;
-    bool GetImage(uint32_t id, uint32_t height, Image& image) override;
+    bool GetImage(uint32_t id, uint32_t height, Image& image, PixelFormat format) override;
 
 private:
+    // index is the ZipReader entry, or the position among the libarchive headers
+    using Page = ArchiveIndex::Entry;
+
     std::string archive_name;
-    std::vector<std::pair<std::string, size_t> > image_files;
+    MappedFile file;
+    std::vector<Page> image_files;
+    std::unique_ptr<ZipReader> zip;
+
+    // libarchive reader for non-ZIP archives, positioned before header next_entry
+    std::mutex stream_mutex;
+    struct archive* stream = nullptr;
+    size_t next_entry = 0;
 
-    bool loadImageFromArchive(uint32_t id, Image& image);
+    static bool IsImage(const std::string& name);
+    bool ScanStream();
+    bool OpenStream();
+    void CloseStream();
+    const uint8_t* ReadEntry(const Page& page, PooledBuffer& buffer, size_t& size);
+    bool loadImageFromArchive(uint32_t id, Image& image, PixelFormat format, uint32_t min_height);
 };
 
 ComicArchive* ComicArchive::Create(const char* filename) {
-    // Use libarchive to determine the type
-    struct archive* arch = archive_read_new();
-    archive_read_support_format_all(arch);
-    archive_read_support_filter_all(arch);
-
-    if (archive_read_open_filename(arch, filename, 10240) != ARCHIVE_OK) {
-        spdlog::error("Failed to open archive: {}", filename);
-        archive_read_free(arch);
+    auto archive = std::make_unique<ComicArchiveImpl>(filename);
+    if (!archive->Open()) {
         return nullptr;
     }
+    spdlog::info("Opened archive: {}", filename);
+    return archive.release();
+}
 
-    struct archive_entry* entry;
-    if (archive_read_next_header(arch, &entry) == ARCHIVE_OK) {
-        spdlog::info("Opened archive: {}", filename);
-        archive_read_close(arch);
-        archive_read_free(arch);
-        return new ComicArchiveImpl(filename);
-    }
+ComicArchiveImpl::ComicArchiveImpl(const char* archive_name) : archive_name(archive_name) {
+}
 
-    spdlog::error("Invalid archive format: {}", filename);
-    archive_read_close(arch);
-    archive_read_free(arch);
-    return nullptr;
+bool ComicArchiveImpl::IsImage(const std::string& name) {
+    return name.find(".jpg") != std::string::npos || name.find(".jpeg") != std::string::npos || name.find(".png") != std::string::npos;
 }
 
-ComicArchiveImpl::ComicArchiveImpl(const char* archive_name) : archive_name(archive_name) {
-    struct archive* arch = archive_read_new();
-    archive_read_support_format_all(arch);
-    archive_read_support_filter_all(arch);
+bool ComicArchiveImpl::Open() {
+    if (!file.Open(archive_name.c_str())) {
+        return false;
+    }
 
-    if (archive_read_open_filename(arch, archive_name, 10240) != ARCHIVE_OK) {
-        spdlog::error("Failed to open archive: {}", archive_name);
-        archive_read_free(arch);
-        return;
+    auto reader = std::make_unique<ZipReader>();
+    if (reader->Open(file.Data(), file.Size(), archive_name.c_str())) {
+        const auto& entries = reader->Entries();
+        bool readable = true;
+        for (size_t i = 0; i < entries.size(); i++) {
+            std::string fname = entries[i].name;
+            std::transform(fname.begin(), fname.end(), fname.begin(), ::tolower);
+            if (IsImage(fname)) {
+                image_files.push_back({ fname, i });
+                readable = readable && ZipReader::CanRead(entries[i]);
+            }
+        }
+        if (readable) {
+            zip = std::move(reader);
+        } else {
+            // e.g. encrypted pages: leave those to libarchive
+            spdlog::debug("{}: ZIP entries need libarchive", archive_name);
+            image_files.clear();
+        }
     }
 
+    struct stat st;
+    ArchiveIndex::Key index_key { archive_name, file.Size(), stat(archive_name.c_str(), &st) == 0 ? st.st_mtime : 0 };
+    if (!zip) {
+        if (ArchiveIndex::Load(index_key, image_files)) {
+            return true; // stored sorted
+        }
+        if (!ScanStream()) {
+            return false;
+        }
+    }
+
+    std::sort(image_files.begin(), image_files.end(), [](const Page& a, const Page& b) {
+        return a.name < b.name;
+        });
+    spdlog::debug("Found and sorted {} image files in archive.", image_files.size());
+    if (!zip) {
+        ArchiveIndex::Store(index_key, image_files);
+    }
+    return true;
+}
+
+// List the pages by walking every libarchive header, which decompresses solid archives whole
+bool ComicArchiveImpl::ScanStream() {
+    if (!OpenStream()) {
+        return false;
+    }
     struct archive_entry* entry;
-    size_t entryId = 1;
-    while (archive_read_next_header(arch, &entry) == ARCHIVE_OK) 
+    size_t entryId = 0;
+    while (archive_read_next_header(stream, &entry) == ARCHIVE_OK)
     {
         const char* filename = archive_entry_pathname(entry);
         std::string fname(filename ? filename : "");
 
         std::transform(fname.begin(), fname.end(), fname.begin(), ::tolower);
 
-        if (fname.find(".jpg") != std::string::npos || fname.find(".jpeg") != std::string::npos || fname.find(".png") != std::string::npos) {
-            image_files.push_back(std::make_pair(fname, entryId));
+        if (IsImage(fname)) {
+            image_files.push_back({ fname, entryId });
         }
-        archive_read_data_skip(arch);
+        archive_read_data_skip(stream);
         ++entryId;
     }
+    CloseStream();
+    if (entryId == 0) {
+        spdlog::error("Invalid archive format: {}", archive_name);
+        return false;
+    }
+    return true;
+}
+
+ComicArchiveImpl::~ComicArchiveImpl() {
+    CloseStream();
+}
 
-    archive_read_close(arch);
-    archive_read_free(arch);
+bool ComicArchiveImpl::OpenStream() {
+    stream = archive_read_new();
+    archive_read_support_format_all(stream);
+    archive_read_support_filter_all(stream);
+    next_entry = 0;
 
-    std::sort(image_files.begin(), image_files.end(), [](const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) {
-        return a.first < b.first;
-        });
-    spdlog::debug("Found and sorted {} image files in archive.", image_files.size());
+    if (archive_read_open_memory(stream, file.Data(), file.Size()) != ARCHIVE_OK) {
+        spdlog::error("Failed to open archive: {}", archive_name);
+        archive_read_free(stream);
+        stream = nullptr;
+        return false;
+    }
+    return true;
 }
 
-ComicArchiveImpl::~ComicArchiveImpl() {
-    // No explicit cleanup needed; libarchive handles resources internally.
+void ComicArchiveImpl::CloseStream() {
+    if (stream) {
+        archive_read_close(stream);
+        archive_read_free(stream);
+        stream = nullptr;
+    }
 }
 
 uint32_t ComicArchiveImpl::GetImageCount() {
     return image_files.size();
 }
 
-bool ComicArchiveImpl::GetImage(uint32_t id, uint32_t resized_height, Image& image) {
+bool ComicArchiveImpl::GetImage(uint32_t id, uint32_t resized_height, Image& image, PixelFormat format) {
     if (id >= GetImageCount()) {
         spdlog::error("Invalid image ID: {} / {}", id, GetImageCount());
         return false;
     }
 
-    if (!loadImageFromArchive(id, image)) {
+    if (!loadImageFromArchive(id, image, format, resized_height)) {
         spdlog::error("Failed to load image with ID {}", id);
         return false;
     }
 
-    // Resize the image if needed
-    if (resized_height != 0)
+    // Resize the image if needed; the decoders may already have done part or all of it
+    if (resized_height != 0 && static_cast<uint32_t>(image.height) != resized_height)
     {
         // Resize the image to a height of "resized_height" pixels, maintaining aspect ratio
-        int resized_width;
         spdlog::debug("Resizing image to target height {} pixels", resized_height);
-        //save_image_as_tga((const char*)rgb_buf, width, height, is_rgb, "/home/root/in.tga");
-        char* resized_image = resize_image_lanczos(image.data, image.width, image.height, resized_height, resized_width, image.is_rgb);
-        delete[] image.data;
-        image.data = resized_image;
-        image.width = resized_width;
-        image.height = resized_height;
+        resize_image_lanczos(image, resized_height, image);
     }
     return true;
 }
 
-bool ComicArchiveImpl::loadImageFromArchive(uint32_t id, Image& image) {
-    struct archive* arch = archive_read_new();
-    archive_read_support_format_all(arch);
-    archive_read_support_filter_all(arch);
-
-    if (archive_read_open_filename(arch, archive_name.c_str(), 10240) != ARCHIVE_OK) {
-        spdlog::error("Failed to open archive: {}", archive_name);
-        archive_read_free(arch);
-        return false;
+// The compressed page file: in place in the mapping when the archive stores it as is,
+// otherwise extracted into buffer. nullptr on failure.
+const uint8_t* ComicArchiveImpl::ReadEntry(const Page& page, PooledBuffer& buffer, size_t& size) {
+    if (zip) {
+        const auto& entry = zip->Entries()[page.index];
+        if (entry.size > MAX_PAGE_FILE_SIZE) {
+            spdlog::error("{} in {} claims {} bytes", page.name, archive_name, entry.size);
+            return nullptr;
+        }
+        size = entry.size;
+        // fault the whole entry in with one request rather than page by page as the decoder walks it
+        file.WillNeed(zip->DataOffset(entry), entry.compressed_size);
+        return zip->Read(entry, buffer);
     }
-    
-    struct archive_entry* entry;
-    void* buffer = nullptr;
-    size_t buffer_size = 0;
-    bool success = false;
 
-    //skip to file
-    for (size_t i = 0; i < image_files[id].second; ++i)
-        archive_read_next_header(arch, &entry);
+    std::lock_guard lock(stream_mutex);
+    // libarchive only reads forward: going back means starting over
+    if (stream && page.index < next_entry) {
+        CloseStream();
+    }
+    if (!stream && !OpenStream()) {
+        return nullptr;
+    }
 
-    //read it   
-    const char* filename = archive_entry_pathname(entry);
-    spdlog::error("check: {} > {}", filename, image_files[id].first);
-    buffer_size = archive_entry_size(entry);
-    buffer = malloc(buffer_size);
-    if (buffer) 
-    {
-        spdlog::error("allocated");
-        ssize_t retcode = archive_read_data(arch, buffer, buffer_size);
-        spdlog::error("retcode {}", retcode);
-        if (retcode > 0) {
-            spdlog::error("loaded");
-            std::string ext = image_files[id].first.substr(image_files[id].first.find_last_of("."));
-            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-            spdlog::error("extention:  {}", ext);
-            if (ext == ".png") {
-                success = load_png_from_memory((const unsigned char*)buffer, buffer_size, image);
-            }
-            else if (ext == ".jpg" || ext == ".jpeg") {
-                success = load_jpeg_from_memory((const unsigned char*)buffer, buffer_size, image);
-            }
+    struct archive_entry* entry = nullptr;
+    for (; next_entry <= page.index; next_entry++) {
+        if (archive_read_next_header(stream, &entry) != ARCHIVE_OK) {
+            spdlog::error("Failed to reach {} in {}", page.name, archive_name);
+            CloseStream();
+            return nullptr;
         }
-        free(buffer);
     }
-    
-    archive_read_close(arch);
-    archive_read_free(arch);
+
+    if (archive_entry_size(entry) <= 0 || archive_entry_size(entry) > MAX_PAGE_FILE_SIZE) {
+        spdlog::error("Bad size {} for {} in {}", archive_entry_size(entry), page.name, archive_name);
+        return nullptr;
+    }
+    size = archive_entry_size(entry);
+    // compressed pages come back at similar sizes, so this is usually a pool hit
+    try {
+        buffer = PooledBuffer(size);
+    } catch (const std::bad_alloc&) {
+        spdlog::error("No memory to read {} ({} bytes)", page.name, size);
+        return nullptr;
+    }
+    ssize_t retcode = archive_read_data(stream, buffer.Get(), size);
+    spdlog::debug("read {}: {}", archive_entry_pathname(entry), retcode);
+    return retcode > 0 ? buffer.Get() : nullptr;
+}
+
+bool ComicArchiveImpl::loadImageFromArchive(uint32_t id, Image& image, PixelFormat format, uint32_t min_height) {
+    const Page& page = image_files[id];
+    PooledBuffer buffer;
+    size_t buffer_size = 0;
+    const uint8_t* data = ReadEntry(page, buffer, buffer_size);
+    if (!data) {
+        return false;
+    }
+
+    bool success = false;
+    std::string ext = page.name.substr(page.name.find_last_of("."));
+    spdlog::debug("extention:  {}", ext);
+    if (ext == ".png") {
+        success = load_png_from_memory(data, buffer_size, image, format, min_height);
+    }
+    else if (ext == ".jpg" || ext == ".jpeg") {
+        success = load_jpeg_from_memory(data, buffer_size, image, format, min_height);
+    }
     return success;
-}
\ No newline at end of file
+}
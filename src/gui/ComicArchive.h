@@ -1,5 +1,6 @@
 #ifndef COMIC_ARCHIVE_H
 #define COMIC_ARCHIVE_H
+#include <string>
 #include <vector>
 #include "lvgl_renderer.h"
 #include "ImageIo.h"
@@ -9,8 +10,11 @@ public:
     static ComicArchive* Create(const char* filename);
 
     virtual ~ComicArchive() = default;
+    virtual const std::string& GetFilename() const = 0;
     virtual uint32_t GetImageCount() = 0;
-    virtual bool GetImage(uint32_t id, uint32_t height, Image& image) = 0;
+    // Decode page id in format (gray pages come out as L8), resized to height rows unless it is 0.
+    // Safe to call from several threads at once.
+    virtual bool GetImage(uint32_t id, uint32_t height, Image& image, PixelFormat format) = 0;
 
 protected:
     ComicArchive() = default;
@@ -0,0 +1,139 @@
+#include "ImageBuffer.h"
+#include "../utils/stats.h"
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// enough for a handful of decoded pages and their scratch rows
+constexpr size_t MAX_CACHED_BYTES = 64 * 1024 * 1024;
+
+struct PoolState {
+    std::mutex mutex;
+    std::map<size_t, std::vector<void*>> free_lists;
+    size_t cached_bytes = 0;
+};
+
+PoolState& State()
+{
+    // buffers may be freed from static destructors, so the pool is never destroyed
+    static PoolState* state = new PoolState();
+    return *state;
+}
+
+// rounds up to one of eight steps per power of two, so at most 12.5% is wasted
+size_t ClassSize(size_t size)
+{
+    size_t step = ImagePool::ALIGNMENT;
+    if (size > 8 * ImagePool::ALIGNMENT) {
+        int top_bit = 63 - __builtin_clzll(size);
+        step = size_t(1) << (top_bit - 3);
+    }
+    return (size + step - 1) / step * step;
+}
+
+}
+
+void* ImagePool::Allocate(size_t size)
+{
+    static auto& hits = stats::get("image_pool.hits");
+    static auto& misses = stats::get("image_pool.misses");
+    static auto& cached = stats::get("image_pool.cached_bytes");
+
+    size_t class_size = ClassSize(size);
+    auto& state = State();
+    {
+        std::lock_guard lock(state.mutex);
+        auto it = state.free_lists.find(class_size);
+        if (it != state.free_lists.end() && !it->second.empty()) {
+            void* buffer = it->second.back();
+            it->second.pop_back();
+            state.cached_bytes -= class_size;
+            cached.set(state.cached_bytes);
+            hits.add(1);
+            return buffer;
+        }
+    }
+
+    misses.add(1);
+    void* buffer = std::aligned_alloc(ALIGNMENT, class_size);
+    if (!buffer) {
+        throw std::bad_alloc();
+    }
+    return buffer;
+}
+
+void ImagePool::Free(void* buffer, size_t size)
+{
+    static auto& cached = stats::get("image_pool.cached_bytes");
+
+    if (!buffer) {
+        return;
+    }
+
+    size_t class_size = ClassSize(size);
+    auto& state = State();
+    {
+        std::lock_guard lock(state.mutex);
+        if (state.cached_bytes + class_size <= MAX_CACHED_BYTES) {
+            state.free_lists[class_size].push_back(buffer);
+            state.cached_bytes += class_size;
+            cached.set(state.cached_bytes);
+            return;
+        }
+    }
+    std::free(buffer);
+}
+
+void ImagePool::Trim()
+{
+    auto& state = State();
+    std::lock_guard lock(state.mutex);
+    for (auto& [class_size, buffers] : state.free_lists) {
+        for (void* buffer : buffers) {
+            std::free(buffer);
+        }
+    }
+    state.free_lists.clear();
+    state.cached_bytes = 0;
+    stats::get("image_pool.cached_bytes").set(0);
+}
+
+PooledBuffer::PooledBuffer(size_t size)
+    : data(static_cast<uint8_t*>(ImagePool::Allocate(size)))
+    , size(size)
+{
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : data(std::exchange(other.data, nullptr))
+    , size(std::exchange(other.size, 0))
+{
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other) {
+        Reset();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+    return *this;
+}
+
+uint8_t* PooledBuffer::Release()
+{
+    size = 0;
+    return std::exchange(data, nullptr);
+}
+
+void PooledBuffer::Reset()
+{
+    ImagePool::Free(data, size);
+    data = nullptr;
+    size = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef IMAGE_BUFFER_H
+#define IMAGE_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Process-wide free lists of 64-byte aligned buffers, bucketed into size classes
+// eight per power of two. Page decodes, resizes and their scratch rows come back
+// at the same few sizes on every page turn, so they are served from the lists
+// instead of the heap. Thread safe.
+class ImagePool {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    static void* Allocate(size_t size);
+    // size must be the size the buffer was allocated with
+    static void Free(void* buffer, size_t size);
+    // Return every cached buffer to the heap
+    static void Trim();
+};
+
+// Move-only owner of one ImagePool buffer
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    explicit PooledBuffer(size_t size);
+    ~PooledBuffer() { Reset(); }
+
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    uint8_t* Get() const { return data; }
+    size_t Size() const { return size; }
+
+    // Give up ownership; free the result with ImagePool::Free(buffer, Size()) taken beforehand
+    uint8_t* Release();
+    void Reset();
+
+private:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+#endif // IMAGE_BUFFER_H
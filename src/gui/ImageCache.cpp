@@ -0,0 +1,146 @@
+#include "ImageCache.h"
+#include "../constants.h"
+#include "../utils/stats.h"
+#include <cstdlib>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+constexpr size_t DEFAULT_BUDGET_MB = 32;
+
+struct CacheNode {
+    lv_cache_slot_size_t slot; // must come first: lru_rb_size reads the entry's byte size from it
+    char* key;
+    uint8_t* pixels; // from ImagePool, dsc.data_size bytes
+    lv_image_dsc_t dsc;
+};
+
+lv_cache_compare_res_t compare_cb(const CacheNode* lhs, const CacheNode* rhs)
+{
+    int res = std::strcmp(lhs->key, rhs->key);
+    return res == 0 ? 0 : (res > 0 ? 1 : -1);
+}
+
+// the node handed to lv_cache_add is a copy of our search key; take ownership of its strings
+bool create_cb(CacheNode* node, void*)
+{
+    node->key = strdup(node->key);
+    stats::get("image_cache.bytes").add(node->slot.size);
+    return node->key != nullptr;
+}
+
+// user_data passed to lv_cache_drop and lv_cache_release, which free entries we asked to
+// forget; lv_cache_add gets nullptr, so frees it triggers are evictions to make room
+char explicit_drop;
+
+void free_cb(CacheNode* node, void* user_data)
+{
+    stats::get("image_cache.bytes").add(-static_cast<int64_t>(node->slot.size));
+    if (user_data != &explicit_drop) {
+        stats::get("image_cache.evictions").add(1);
+    }
+    std::free(node->key);
+    ImagePool::Free(node->pixels, node->dsc.data_size);
+}
+
+void free_uncached_cb(lv_event_t* e)
+{
+    auto node = static_cast<CacheNode*>(lv_event_get_user_data(e));
+    ImagePool::Free(node->pixels, node->dsc.data_size);
+    delete node;
+}
+
+void fill_descriptor(CacheNode& node, Image& image)
+{
+    node.dsc = {};
+    node.dsc.data_size = image.Size();
+    node.pixels = image.Release(); // the cache owns the pixels from here on
+    node.dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+    node.dsc.header.w = image.width;
+    node.dsc.header.h = image.height;
+    node.dsc.header.stride = image.stride;
+    node.dsc.header.cf = ToLvColorFormat(image.format);
+    node.dsc.data = node.pixels;
+    node.slot.size = node.dsc.data_size;
+}
+
+}
+
+lv_color_format_t ToLvColorFormat(PixelFormat format)
+{
+    return format == PixelFormat::L8 ? LV_COLOR_FORMAT_L8
+        : (format == PixelFormat::RGB888 ? LV_COLOR_FORMAT_RGB888 : LV_COLOR_FORMAT_ARGB8888);
+}
+
+ImageCache& ImageCache::GetInstance()
+{
+    // lives as long as the process, like lvgl itself, so it is never destroyed
+    static ImageCache* instance = new ImageCache();
+    return *instance;
+}
+
+ImageCache::ImageCache()
+{
+    size_t budget_mb = DEFAULT_BUDGET_MB;
+    if (auto env = std::getenv(ENV_IMAGE_CACHE_MB)) {
+        budget_mb = std::strtoul(env, nullptr, 10);
+    }
+
+    lv_cache_ops_t ops {};
+    ops.compare_cb = (lv_cache_compare_cb_t)compare_cb;
+    ops.create_cb = (lv_cache_create_cb_t)create_cb;
+    ops.free_cb = (lv_cache_free_cb_t)free_cb;
+    cache = lv_cache_create(&lv_cache_class_lru_rb_size, sizeof(CacheNode), budget_mb * 1024 * 1024, ops);
+    lv_cache_set_name(cache, "bifrost_images");
+    spdlog::debug("Image cache budget: {} MB", budget_mb);
+}
+
+bool ImageCache::SetImageSource(lv_obj_t* obj, const std::string& key, const Loader& loader)
+{
+    static auto& hits = stats::get("image_cache.hits");
+    static auto& misses = stats::get("image_cache.misses");
+
+    CacheNode search {};
+    search.key = const_cast<char*>(key.c_str());
+
+    auto entry = lv_cache_acquire(cache, &search, nullptr);
+    if (entry) {
+        hits.add(1);
+    } else {
+        misses.add(1);
+        Image image;
+        if (!loader(image)) {
+            return false;
+        }
+        fill_descriptor(search, image);
+        entry = lv_cache_add(cache, &search, nullptr);
+        if (!entry) {
+            // larger than the budget, or everything left in the cache is on screen
+            spdlog::warn("Image cache full, {} is not cached", key);
+            auto node = new CacheNode(search);
+            node->key = nullptr;
+            lv_image_set_src(obj, &node->dsc);
+            lv_obj_add_event_cb(obj, free_uncached_cb, LV_EVENT_DELETE, node);
+            return true;
+        }
+    }
+
+    auto node = static_cast<CacheNode*>(lv_cache_entry_get_data(entry));
+    lv_image_set_src(obj, &node->dsc);
+    lv_obj_add_event_cb(obj, ReleaseEntry, LV_EVENT_DELETE, entry);
+    return true;
+}
+
+void ImageCache::ReleaseEntry(lv_event_t* e)
+{
+    auto entry = static_cast<lv_cache_entry_t*>(lv_event_get_user_data(e));
+    lv_cache_release(GetInstance().cache, entry, &explicit_drop);
+}
+
+void ImageCache::Drop(const std::string& key)
+{
+    CacheNode search {};
+    search.key = const_cast<char*>(key.c_str());
+    lv_cache_drop(cache, &search, &explicit_drop);
+}
@@ -0,0 +1,42 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <functional>
+#include <string>
+#include "lvgl_renderer.h"
+#include "ImageIo.h"
+
+// Decoded images (thumbnails, pages) shared by key and kept in an LVGL
+// lru_rb_size cache under a byte budget. An entry stays pinned while an
+// lv_image shows it and becomes evictable once that object is deleted.
+class ImageCache {
+public:
+    // Fills image on a cache miss; returns false if the image can't be produced
+    using Loader = std::function<bool(Image&)>;
+
+    static ImageCache& GetInstance();
+
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    // Point the lv_image obj at the cached image for key, running loader on a miss.
+    // LVGL thread only. Returns false (and leaves obj untouched) if loader failed.
+    bool SetImageSource(lv_obj_t* obj, const std::string& key, const Loader& loader);
+
+    // Forget key, e.g. when the file behind it changed. A pinned entry is freed
+    // once the last object showing it is deleted.
+    void Drop(const std::string& key);
+
+private:
+    ImageCache();
+
+    // LV_EVENT_DELETE handler unpinning the entry an object was showing
+    static void ReleaseEntry(lv_event_t* e);
+
+    lv_cache_t* cache = nullptr;
+};
+
+// The LVGL color format with the same memory layout as format
+lv_color_format_t ToLvColorFormat(PixelFormat format);
+
+#endif // IMAGE_CACHE_H
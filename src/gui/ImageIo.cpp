@@ -1,5 +1,8 @@
 #include "ImageIo.h"
+#include "ImageResampler.h"
+#include "../utils/pixel_convert.h"
 #include <fstream>
+#include <cstring>
 #include <cmath>
 #include <vector>
 #include <iostream>
@@ -7,7 +10,7 @@
 #include <turbojpeg.h>
 #include <spdlog/spdlog.h>
 
-bool save_image_as_tga(Image& image, const char* filename)
+bool save_image_as_tga(const Image& image, const char* filename)
 {
     // Ouvre le fichier en mode binaire
     std::ofstream file(filename, std::ios::binary);
@@ -16,37 +19,39 @@ bool save_image_as_tga(Image& image, const char* filename)
         return false;
     }
 
-    // Taille d'un pixel en octets (3 pour RGB, 1 pour grayscale)
-    int pixel_size = image.is_rgb ? 3 : 1;
+    // Taille d'un pixel en octets (4 pour ARGB8888, 3 pour RGB, 1 pour grayscale)
+    int pixel_size = BytesPerPixel(image.format);
 
     // Prpare l'en-tte TGA
     unsigned char header[18];
     std::memset(header, 0, sizeof(header));  // Initialise tout l'en-tte  0
-    header[2] = 2;  // Type d'image: 2 pour une image non compresse en Truecolor
+    header[2] = image.format == PixelFormat::L8 ? 3 : 2;  // Type d'image: 2 Truecolor, 3 grayscale, non compress
     header[12] = image.width & 0xFF;        // Largeur (octet bas)
     header[13] = (image.width >> 8) & 0xFF; // Largeur (octet haut)
     header[14] = image.height & 0xFF;       // Hauteur (octet bas)
     header[15] = (image.height >> 8) & 0xFF; // Hauteur (octet haut)
-    header[16] = pixel_size * 8;      // Profondeur de couleur: 24 bits pour RGB, 8 bits pour grayscale
+    header[16] = pixel_size * 8;      // Profondeur de couleur: 32 bits pour BGRA, 24 bits pour RGB, 8 bits pour grayscale
+    header[17] = image.format == PixelFormat::ARGB8888 ? 8 : 0; // bits d'alpha
 
     // crit l'en-tte dans le fichier
     file.write(reinterpret_cast<const char*>(header), sizeof(header));
 
     // crit les donnes d'image dans le fichier
     // Note : Les donnes TGA sont en ordre BGR pour RGB (on inverse R et B pour chaque pixel)
+    // ARGB8888 is already B, G, R, A in memory, like TGA; gray is stored as is
     for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            const char* pixel = image.data + (y * image.width + x) * pixel_size;
-            if (image.is_rgb) {
+        auto row = reinterpret_cast<const char*>(image.Row(y));
+        if (image.format != PixelFormat::RGB888) {
+            file.write(row, static_cast<std::streamsize>(image.width) * pixel_size);
+        }
+        else {
+            for (int x = 0; x < image.width; ++x) {
+                const char* pixel = row + x * pixel_size;
                 // crire en ordre BGR pour le format TGA
                 file.put(pixel[2]); // B
                 file.put(pixel[1]); // G
                 file.put(pixel[0]); // R
             }
-            else {
-                // Grayscale (1 octet par pixel)
-                file.put(pixel[0]);
-            }
         }
     }
 
@@ -55,7 +60,7 @@ bool save_image_as_tga(Image& image, const char* filename)
     return true;
 }
 
-bool load_image_as_tga(Image& image, const char* filename)
+bool load_image_as_tga(Image& image, const char* filename, PixelFormat format)
 {
     // Ouvre le fichier en mode binaire
     std::ifstream file(filename, std::ios::binary);
@@ -74,7 +79,7 @@ bool load_image_as_tga(Image& image, const char* filename)
     }
 
     // Vrifie le type d'image (seuls les types non compresss Truecolor ou grayscale sont pris en charge)
-    if (header[2] != 2) {
+    if (header[2] != 2 && header[2] != 3) {
         spdlog::debug("Erreur: Type d'image TGA non pris en charge (type: {}).", header[2]);
         return false;
     }
@@ -84,50 +89,51 @@ bool load_image_as_tga(Image& image, const char* filename)
     int height = header[14] | (header[15] << 8);
     int bits_per_pixel = header[16];
 
-    if (bits_per_pixel != 24 && bits_per_pixel != 8) {
+    if (bits_per_pixel != 32 && bits_per_pixel != 24 && bits_per_pixel != 8) {
         spdlog::debug("Erreur: Profondeur de couleur non prise en charge ({} bits).", bits_per_pixel);
         return false;
     }
 
-    bool is_rgb = (bits_per_pixel == 24);
-    int pixel_size = is_rgb ? 3 : 1;
-
-    // Alloue la mmoire pour les donnes de l'image
-    char* data = new char[width * height * pixel_size];
-    if (!data) {
-        spdlog::debug("Erreur: chec d'allocation mmoire pour l'image.");
-        return false;
-    }
-
-    // Lis les donnes de l'image
-    file.read(data, width * height * pixel_size);
-
-    if (!file) {
-        spdlog::debug("Erreur: chec de lecture des donnes d'image dans {}.", filename);
-        delete[] data;
-        return false;
+    // Convert to the requested format row by row; gray files stay gray
+    int file_pixel_size = bits_per_pixel / 8;
+    if (file_pixel_size == 1) {
+        format = PixelFormat::L8;
     }
+    Image loaded(width, height, format);
+    PooledBuffer row(static_cast<size_t>(width) * file_pixel_size);
+    auto src = row.Get();
+    for (int y = 0; y < height; ++y) {
+        // Lis une ligne telle quelle (B, G, R[, A] ou gris)
+        if (!file.read(reinterpret_cast<char*>(src), row.Size())) {
+            spdlog::debug("Erreur: chec de lecture des donnes d'image dans {}.", filename);
+            return false;
+        }
 
-    // Inverser l'ordre des couleurs pour les images RGB (BGR -> RGB)
-    if (is_rgb) {
-        for (int i = 0; i < width * height; ++i) {
-            std::swap(data[i * 3], data[i * 3 + 2]); // change B et R
+        uint8_t* dst = loaded.Row(y);
+        if (file_pixel_size == 1 || (file_pixel_size == 4 && format == PixelFormat::ARGB8888)) {
+            std::memcpy(dst, src, row.Size());
+        } else if (file_pixel_size == 3 && format == PixelFormat::ARGB8888) {
+            expand_bgr888_to_argb8888(src, reinterpret_cast<uint32_t*>(dst), width);
+        } else if (file_pixel_size == 4 && format == PixelFormat::L8) {
+            reduce_argb8888_to_l8(reinterpret_cast<const uint32_t*>(src), dst, width);
+        } else {
+            // BGR(A) -> RGB888 or BGR -> L8, only seen with thumbnails from older versions
+            for (int x = 0; x < width; ++x) {
+                const uint8_t* pixel = src + x * file_pixel_size;
+                if (format == PixelFormat::RGB888) {
+                    dst[x * 3] = pixel[2];
+                    dst[x * 3 + 1] = pixel[1];
+                    dst[x * 3 + 2] = pixel[0];
+                } else {
+                    dst[x] = static_cast<uint8_t>((pixel[2] * 77 + pixel[1] * 150 + pixel[0] * 29 + 128) >> 8);
+                }
+            }
         }
     }
-
-    // Ferme le fichier
     file.close();
 
-    // Libre les donnes prcdentes de l'image (si elles existent)
-    if (image.data) {
-        delete[] image.data;
-    }
-
-    // Remplit les champs de l'objet Image
-    image.data = data;
-    image.width = width;
-    image.height = height;
-    image.is_rgb = is_rgb;
+    // Remplace l'image (les donnes prcdentes retournent au pool)
+    image = std::move(loaded);
 
     spdlog::debug("Image charge avec succs depuis {}", filename);
     return true;
@@ -146,7 +152,27 @@ void cleanup_png(PngReadStructs& png_structs) {
 }
 
 
-bool load_png_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image)
+// libpng reports errors by longjmp; these wrappers catch it in a frame without C++ objects
+// so that callers holding vectors or a resampler can unwind normally
+static bool read_png_row(png_structp png_ptr, png_bytep row)
+{
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        return false;
+    }
+    png_read_row(png_ptr, row, nullptr);
+    return true;
+}
+
+static bool read_png_image(png_structp png_ptr, png_bytepp rows)
+{
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        return false;
+    }
+    png_read_image(png_ptr, rows);
+    return true;
+}
+
+bool load_png_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image, PixelFormat format, int target_height)
 {
     spdlog::debug("Initializing PNG decoder");
 
@@ -172,28 +198,46 @@ bool load_png_from_memory(const unsigned char* dataBuf, unsigned int size, Image
         return false;
     }
 
-    // Initialize memory read stream
-    png_set_read_fn(png_structs.png_ptr, const_cast<unsigned char*>(dataBuf),
+    // Initialize memory read stream; the io pointer is a cursor into dataBuf
+    struct ReadCursor {
+        const unsigned char* pos;
+        const unsigned char* end;
+    } cursor = { dataBuf, dataBuf + size };
+    png_set_read_fn(png_structs.png_ptr, &cursor,
         [](png_structp png_ptr, png_bytep data, png_size_t length) {
-            unsigned char** p = reinterpret_cast<unsigned char**>(png_get_io_ptr(png_ptr));
-            memcpy(data, *p, length);
-            *p += length;
+            auto cursor = reinterpret_cast<ReadCursor*>(png_get_io_ptr(png_ptr));
+            if (static_cast<size_t>(cursor->end - cursor->pos) < length) {
+                png_error(png_ptr, "PNG data truncated");
+            }
+            memcpy(data, cursor->pos, length);
+            cursor->pos += length;
         });
 
     // Read PNG header info
     png_read_info(png_structs.png_ptr, png_structs.info_ptr);
 
     // Get dimensions and color type
+    png_uint_32 png_width, png_height;
     int color_type, bit_depth;
-    png_get_IHDR(png_structs.png_ptr, png_structs.info_ptr, (unsigned int*) &image.width, (unsigned int*) &image.height, &bit_depth, &color_type, nullptr, nullptr, nullptr);
+    png_get_IHDR(png_structs.png_ptr, png_structs.info_ptr, &png_width, &png_height, &bit_depth, &color_type, nullptr, nullptr, nullptr);
+    int width = png_width;
+    int height = png_height;
 
-    // Force conversion to RGB
-    image.is_rgb = true;
+    // Let libpng produce the target format; gray images stay gray
+    bool is_gray = color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA;
+    PixelFormat out_format = is_gray ? PixelFormat::L8 : format;
     if (color_type == PNG_COLOR_TYPE_PALETTE) {
         png_set_palette_to_rgb(png_structs.png_ptr); // Convert palette images to RGB
     }
-    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
-        png_set_gray_to_rgb(png_structs.png_ptr); // Convert grayscale or grayscale+alpha to RGB
+    if (is_gray && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png_structs.png_ptr);
+    }
+    if (!is_gray && out_format == PixelFormat::L8) {
+        png_set_rgb_to_gray_fixed(png_structs.png_ptr, 1, -1, -1); // default BT.709 weights
+    }
+    if (out_format == PixelFormat::ARGB8888) {
+        png_set_bgr(png_structs.png_ptr);
+        png_set_filler(png_structs.png_ptr, 0xff, PNG_FILLER_AFTER); // opaque, after the alpha is stripped
     }
     if (png_get_valid(png_structs.png_ptr, png_structs.info_ptr, PNG_INFO_tRNS) || color_type & PNG_COLOR_MASK_ALPHA) {
         png_set_strip_alpha(png_structs.png_ptr); // Strip any alpha channel
@@ -201,33 +245,81 @@ bool load_png_from_memory(const unsigned char* dataBuf, unsigned int size, Image
     if (bit_depth == 16) {
         png_set_strip_16(png_structs.png_ptr); // Convert 16-bit to 8-bit
     }
+    // Adam7 rows only become final on the last pass, so interlaced images can't be streamed
+    bool interlaced = png_get_interlace_type(png_structs.png_ptr, png_structs.info_ptr) != PNG_INTERLACE_NONE;
+    if (interlaced) {
+        png_set_interlace_handling(png_structs.png_ptr);
+    }
 
     // Update PNG info after transformations
     png_read_update_info(png_structs.png_ptr, png_structs.info_ptr);
 
-    // Allocate memory for RGB data (3 bytes per pixel)
-    image.data = new char[image.width * image.height * 3];
-    if (!image.data) {
-        spdlog::error("Failed to allocate memory for decoded PNG image");
-        cleanup_png(png_structs);
-        return false;
-    }
+    int pixel_size = BytesPerPixel(out_format);
+    bool success;
+    if (target_height > 0 && !interlaced) {
+        // Feed decoded rows straight into the resampler; only one source row is ever held
+        int target_width = (target_height * width) / height;
+        spdlog::debug("Streaming PNG {}x{} into {}x{}", width, height, target_width, target_height);
+        Image resized(target_width, target_height, out_format);
+        PooledBuffer row(static_cast<size_t>(width) * pixel_size);
+        int next_row = 0;
+        success = true;
+        BoxReducer reducer([&](int y) {
+            for (; success && next_row <= y; next_row++) {
+                success = read_png_row(png_structs.png_ptr, row.Get());
+            }
+            return row.Get();
+        }, width, height, pixel_size, BoxReducer::Levels(height, target_height));
+        LanczosResampler(reducer.Width(), reducer.Height(), target_width, target_height, pixel_size)
+            .ResizeStreaming([&](int y) { return reducer.Row(y); }, resized.Row(0), resized.stride);
 
-    // Read image row by row
-    png_bytep row_pointers[image.height];
-    for (int y = 0; y < image.height; ++y) {
-        row_pointers[y] = (unsigned char*)image.data + y * image.width * 3;
+        if (success) {
+            image = std::move(resized);
+        }
+    } else {
+        Image decoded(width, height, out_format);
+        std::vector<png_bytep> row_pointers(height);
+        for (int y = 0; y < height; ++y) {
+            row_pointers[y] = decoded.Row(y);
+        }
+        success = read_png_image(png_structs.png_ptr, row_pointers.data());
+        if (success) {
+            image = std::move(decoded);
+        }
     }
-    png_read_image(png_structs.png_ptr, row_pointers);
 
     // Free libpng resources
     cleanup_png(png_structs);
 
-    return true; // Return RGB buffer
+    if (!success) {
+        spdlog::error("Error decoding PNG");
+    }
+    return success;
 }
 
 
-bool load_jpeg_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image)
+// Pick the TurboJPEG scaling factor with the smallest output that is still at least
+// min_height rows tall, so that the IDCT does most of the downscaling for free.
+static tjscalingfactor pick_jpeg_scaling(int width, int height, int min_height)
+{
+    tjscalingfactor best = { 1, 1 };
+    if (min_height <= 0 || min_height >= height) {
+        return best;
+    }
+
+    int count = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&count);
+    for (int i = 0; factors && i < count; i++) {
+        int scaled_height = TJSCALED(height, factors[i]);
+        if (factors[i].num < factors[i].denom && scaled_height >= min_height && scaled_height < TJSCALED(height, best)
+            && TJSCALED(width, factors[i]) > 0) {
+            best = factors[i];
+        }
+    }
+    return best;
+}
+
+bool load_jpeg_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image, PixelFormat format, int min_height)
 {
     spdlog::debug("Initializing TurboJPEG decoder");
     tjhandle handle = tjInitDecompress();
@@ -236,30 +328,35 @@ bool load_jpeg_from_memory(const unsigned char* dataBuf, unsigned int size, Imag
         return false;
     }
 
-    int jpeg_subsample, jpeg_colorspace;
-    if (tjDecompressHeader3(handle, dataBuf, size, &image.width, &image.height, &jpeg_subsample, &jpeg_colorspace) != 0) {
+    int width, height, jpeg_subsample, jpeg_colorspace;
+    if (tjDecompressHeader3(handle, dataBuf, size, &width, &height, &jpeg_subsample, &jpeg_colorspace) != 0) {
         spdlog::error("Failed to read JPEG header: {}", tjGetErrorStr());
         tjDestroy(handle);
         return false;
     }
 
-    spdlog::debug("JPEG header read: width={}, height={}, colorspace={}", image.width, image.height, jpeg_colorspace);
+    spdlog::debug("JPEG header read: width={}, height={}, colorspace={}", width, height, jpeg_colorspace);
 
-    image.is_rgb = (jpeg_colorspace == TJCS_RGB || jpeg_colorspace == TJCS_YCbCr);
-    int pixel_format = image.is_rgb ? TJPF_RGB : TJPF_GRAY;
+    // TurboJPEG converts straight to the target layout; for gray it only keeps the Y plane
+    bool is_rgb = (jpeg_colorspace == TJCS_RGB || jpeg_colorspace == TJCS_YCbCr);
+    PixelFormat out_format = is_rgb ? format : PixelFormat::L8;
+    int pixel_format = out_format == PixelFormat::L8 ? TJPF_GRAY : (out_format == PixelFormat::RGB888 ? TJPF_RGB : TJPF_BGRA);
 
-    // Allocate buffer for the decompressed image in RGB or grayscale format
-    image.data = new char[image.width * image.height * (image.is_rgb ? 3 : 1)];
-    spdlog::debug("RGB buffer allocated with size: {}", image.width * image.height * (image.is_rgb ? 3 : 1));
+    tjscalingfactor scaling = pick_jpeg_scaling(width, height, min_height);
+    if (scaling.num != scaling.denom) {
+        width = TJSCALED(width, scaling);
+        height = TJSCALED(height, scaling);
+        spdlog::debug("JPEG decoded at {}/{} scale: {}x{}", scaling.num, scaling.denom, width, height);
+    }
 
-    // Decompress JPEG to RGB or grayscale
-    if (tjDecompress2(handle, dataBuf, size, (unsigned char*)image.data, image.width, 0 /* pitch */, image.height, pixel_format, TJFLAG_FASTDCT) != 0) {
+    // Decompress JPEG to the target format, into aligned rows from the pool
+    Image decoded(width, height, out_format);
+    if (tjDecompress2(handle, dataBuf, size, decoded.Row(0), width, decoded.stride, height, pixel_format, TJFLAG_FASTDCT) != 0) {
         spdlog::error("Failed to decompress JPEG: {}", tjGetErrorStr());
         tjDestroy(handle);
-        delete[] image.data;
-        image.data = nullptr;
         return false;
     }
+    image = std::move(decoded);
     spdlog::debug("JPEG decompression completed");
 
     // Clean up the TurboJPEG handle
@@ -269,121 +366,63 @@ bool load_jpeg_from_memory(const unsigned char* dataBuf, unsigned int size, Imag
 }
 
 
-char* resize_image_NearestNeighbor(const char* src, int src_w, int src_h, int tgt_h, int& tgt_w, bool is_rgb) 
+void Image::Allocate(int width, int height, PixelFormat format)
 {
-    spdlog::debug("Resizing image from {}x{} to height {}", src_w, src_h, tgt_h);
-    tgt_w = (tgt_h * src_w) / src_h;  // Calculate target width to maintain aspect ratio
-    int pixel_size = is_rgb ? 3 : 1;  // 3 bytes per pixel for RGB, 1 byte for grayscale
+    size_t row_size = static_cast<size_t>(width) * BytesPerPixel(format);
+    this->stride = (row_size + ImagePool::ALIGNMENT - 1) / ImagePool::ALIGNMENT * ImagePool::ALIGNMENT;
+    this->width = width;
+    this->height = height;
+    this->format = format;
+    buffer = PooledBuffer(stride * height);
+}
+
+
+void resize_image_NearestNeighbor(const Image& src, int tgt_h, Image& dst)
+{
+    spdlog::debug("Resizing image from {}x{} to height {}", src.width, src.height, tgt_h);
+    int tgt_w = (tgt_h * src.width) / src.height;  // Calculate target width to maintain aspect ratio
+    int pixel_size = BytesPerPixel(src.format);
     spdlog::debug("Target width calculated as {}, pixel size: {}", tgt_w, pixel_size);
 
-    // Allocate the resized image buffer
-    char* resized_img = new char[tgt_w * tgt_h * pixel_size];
-    spdlog::debug("Resized image buffer allocated, size: {} bytes", tgt_w * tgt_h * pixel_size);
+    Image resized(tgt_w, tgt_h, src.format);
 
     // Nearest-neighbor resize
     for (int y = 0; y < tgt_h; y++) {
+        const uint8_t* src_row = src.Row(y * src.height / tgt_h);
+        uint8_t* tgt_row = resized.Row(y);
         for (int x = 0; x < tgt_w; x++) {
-            int src_x = x * src_w / tgt_w;
-            int src_y = y * src_h / tgt_h;
-            const char* src_pixel = src + (src_y * src_w + src_x) * pixel_size;
-            char* tgt_pixel = resized_img + (y * tgt_w + x) * pixel_size;
-
-            // Copy pixels depending on RGB or grayscale
-            if (is_rgb) {
-                tgt_pixel[0] = src_pixel[0];
-                tgt_pixel[1] = src_pixel[1];
-                tgt_pixel[2] = src_pixel[2];
-            }
-            else {
-                tgt_pixel[0] = src_pixel[0];
-            }
+            int src_x = x * src.width / tgt_w;
+            std::memcpy(tgt_row + x * pixel_size, src_row + src_x * pixel_size, pixel_size);
         }
     }
+    dst = std::move(resized);
     spdlog::debug("Image resizing completed");
-
-    return resized_img;
 }
 
 
-
-
-// Lanczos kernel function
-inline float lanczos_kernel(float x, int a = 3) {
-    if (x == 0.0f) return 1.0f;
-    if (std::abs(x) >= a) return 0.0f;
-    x *= M_PI;
-    return (a * std::sin(x) * std::sin(x / a)) / (x * x);
-}
-
-// Resizing function using Lanczos filter
-char* resize_image_lanczos(const char* src, int src_w, int src_h, int tgt_h, int& tgt_w, bool is_rgb, int a)
+// Resizing function using a separable Lanczos filter, after box reducing to within 2x of the target
+void resize_image_lanczos(const Image& src, int tgt_h, Image& dst, int a)
 {
-    spdlog::debug("Resizing image from {}x{} to height {} using Lanczos filter", src_w, src_h, tgt_h);
-    tgt_w = (tgt_h * src_w) / src_h;  // Calculate target width to maintain aspect ratio
-    int pixel_size = is_rgb ? 3 : 1;  // 3 bytes per pixel for RGB, 1 byte for grayscale
-    spdlog::debug("Target width calculated as {}, pixel size: {}", tgt_w, pixel_size);
-
-    // Allocate the resized image buffer
-    char* resized_img = new char[tgt_w * tgt_h * pixel_size];
-    spdlog::debug("Resized image buffer allocated, size: {} bytes", tgt_w * tgt_h * pixel_size);
-
-    // Precompute Lanczos kernel weights for efficiency
-    std::vector<float> kernel(2 * a + 1);
-    for (int i = 0; i <= 2 * a; i++) {
-        kernel[i] = lanczos_kernel(i - a, a);
-    }
-
-    // Resizing with Lanczos filter
-    for (int y = 0; y < tgt_h; y++) {
-        for (int x = 0; x < tgt_w; x++) {
-            float src_x = static_cast<float>(x * src_w) / tgt_w;
-            float src_y = static_cast<float>(y * src_h) / tgt_h;
-
-            int src_x_int = static_cast<int>(src_x);
-            int src_y_int = static_cast<int>(src_y);
-
-            float x_weight = src_x - src_x_int;
-            float y_weight = src_y - src_y_int;
-
-            float pixel_sum[3] = { 0.0f, 0.0f, 0.0f };
-            float weight_sum = 0.0f;
-
-            // Lanczos resampling kernel application
-            for (int ky = -a; ky <= a; ky++) {
-                int src_y_sample = std::clamp(src_y_int + ky, 0, src_h - 1);
-                for (int kx = -a; kx <= a; kx++) {
-                    int src_x_sample = std::clamp(src_x_int + kx, 0, src_w - 1);
-
-                    float kernel_x = lanczos_kernel(src_x - (src_x_sample), a);
-                    float kernel_y = lanczos_kernel(src_y - (src_y_sample), a);
-                    float weight = kernel_x * kernel_y;
-
-                    const char* src_pixel = src + (src_y_sample * src_w + src_x_sample) * pixel_size;
-                    weight_sum += weight;
-
-                    if (is_rgb) {
-                        pixel_sum[0] += weight * src_pixel[0];
-                        pixel_sum[1] += weight * src_pixel[1];
-                        pixel_sum[2] += weight * src_pixel[2];
-                    }
-                    else {
-                        pixel_sum[0] += weight * src_pixel[0];
-                    }
-                }
-            }
-
-            char* tgt_pixel = resized_img + (y * tgt_w + x) * pixel_size;
-            if (is_rgb) {
-                tgt_pixel[0] = std::clamp(static_cast<int>(pixel_sum[0] / weight_sum), 0, 255);
-                tgt_pixel[1] = std::clamp(static_cast<int>(pixel_sum[1] / weight_sum), 0, 255);
-                tgt_pixel[2] = std::clamp(static_cast<int>(pixel_sum[2] / weight_sum), 0, 255);
-            }
-            else {
-                tgt_pixel[0] = std::clamp(static_cast<int>(pixel_sum[0] / weight_sum), 0, 255);
-            }
+    spdlog::debug("Resizing image from {}x{} to height {} using Lanczos filter", src.width, src.height, tgt_h);
+    int tgt_w = (tgt_h * src.width) / src.height;  // Calculate target width to maintain aspect ratio
+    int pixel_size = BytesPerPixel(src.format);
+
+    const Image* source = &src;
+    Image reduced;
+    int levels = BoxReducer::Levels(src.height, tgt_h);
+    if (levels > 0) {
+        BoxReducer reducer([&src](int y) { return src.Row(y); }, src.width, src.height, pixel_size, levels);
+        reduced.Allocate(reducer.Width(), reducer.Height(), src.format);
+        for (int y = 0; y < reduced.height; y++) {
+            std::memcpy(reduced.Row(y), reducer.Row(y), static_cast<size_t>(reduced.width) * pixel_size);
         }
+        source = &reduced;
     }
 
+    Image resized(tgt_w, tgt_h, src.format);
+    LanczosResampler(source->width, source->height, tgt_w, tgt_h, pixel_size, a)
+        .Resize(source->Row(0), source->stride, resized.Row(0), resized.stride);
+    dst = std::move(resized);
+
     spdlog::debug("Image resizing completed using Lanczos filter");
-    return resized_img;
 }
\ No newline at end of file
@@ -1,20 +1,71 @@
 #ifndef IMAGE_IO_H
 #define IMAGE_IO_H
 
+#include "ImageBuffer.h"
+#include <utility>
+
+// Pixel layouts the decoders can produce directly
+enum class PixelFormat
+{
+	L8,       // 1 byte gray
+	RGB888,   // R, G, B bytes
+	ARGB8888, // B, G, R, A bytes: LV_COLOR_FORMAT_ARGB8888 on little endian
+};
+
+inline int BytesPerPixel(PixelFormat format)
+{
+	return format == PixelFormat::L8 ? 1 : (format == PixelFormat::RGB888 ? 3 : 4);
+}
+
+// Decoded pixels with 64-byte aligned rows, backed by ImagePool. Move-only: hand an
+// image on with std::move, or Release() its pixels to an owner outside this code.
 class Image
 {
 public:
-	~Image() { if (data) delete[] data; }
-	char* data = nullptr;
+	Image() = default;
+	Image(int width, int height, PixelFormat format) { Allocate(width, height, format); }
+
+	Image(Image&& other) noexcept { *this = std::move(other); }
+	Image& operator=(Image&& other) noexcept
+	{
+		buffer = std::move(other.buffer);
+		width = std::exchange(other.width, 0);
+		height = std::exchange(other.height, 0);
+		stride = std::exchange(other.stride, 0);
+		format = other.format;
+		return *this;
+	}
+
+	// Replaces the pixels with an uninitialized width x height buffer
+	void Allocate(int width, int height, PixelFormat format);
+
+	uint8_t* Row(int y) { return buffer.Get() + y * stride; }
+	const uint8_t* Row(int y) const { return buffer.Get() + y * stride; }
+	size_t Size() const { return stride * height; }
+	bool Empty() const { return !buffer.Get(); }
+
+	// Give up the pixels; free them with ImagePool::Free(pixels, Size()) taken beforehand
+	uint8_t* Release() { return buffer.Release(); }
+
 	int width = 0;
 	int height = 0;
-	bool is_rgb = false;
+	size_t stride = 0; // bytes per row, a multiple of ImagePool::ALIGNMENT
+	PixelFormat format = PixelFormat::RGB888;
+
+private:
+	PooledBuffer buffer;
 };
 
-bool save_image_as_tga(Image& image, const char* filename);
-bool load_image_as_tga(Image& image, const char* filename);
-bool load_png_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image);
-bool load_jpeg_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image);
-char* resize_image_NearestNeighbor(const char* src, int src_w, int src_h, int tgt_h, int& tgt_w, bool is_rgb);
-char* resize_image_lanczos(const char* src, int src_w, int src_h, int tgt_h, int& tgt_w, bool is_rgb, int a = 3);
+// The loaders convert color sources to format; grayscale sources always come out as L8.
+bool save_image_as_tga(const Image& image, const char* filename);
+bool load_image_as_tga(Image& image, const char* filename, PixelFormat format);
+// With target_height set, non-interlaced PNGs are resized to that height row by row while
+// decoding instead of going through a full-size buffer.
+bool load_png_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image, PixelFormat format, int target_height = 0);
+// With min_height set, the JPEG is decoded at the smallest DCT scale (1/2, 1/4, 1/8...) that keeps
+// at least min_height rows; the result still needs a final resize.
+bool load_jpeg_from_memory(const unsigned char* dataBuf, unsigned int size, Image& image, PixelFormat format, int min_height = 0);
+// Resize src to tgt_h rows, keeping the aspect ratio, into dst (same format)
+void resize_image_NearestNeighbor(const Image& src, int tgt_h, Image& dst);
+void resize_image_lanczos(const Image& src, int tgt_h, Image& dst, int a = 3);
 #endif //IMAGE_IO_H
@@ -0,0 +1,360 @@
+#include "ImageResampler.h"
+#include "ImageBuffer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// bands shorter than this cost more in hand-off and row-cache warmup than they save
+constexpr int MIN_BAND_ROWS = 64;
+constexpr int MAX_BANDS = 4;
+
+// The bands of one Resize call. The caller and any idle pool thread claim them one at a time.
+struct BandJob {
+    const std::function<void(int)>& run;
+    const int count;
+    std::atomic<int> next { 0 };
+    int done = 0;    // bands finished; pool mutex
+    int helpers = 0; // pool threads inside the job; pool mutex
+    std::condition_variable finished;
+};
+
+// MAX_BANDS - 1 threads shared by every resize in the process, so that concurrent callers
+// such as the prefetch workers queue their bands instead of each starting their own threads
+class BandPool {
+public:
+    static BandPool& GetInstance()
+    {
+        // the threads run for the life of the process, so the pool is never destroyed
+        static BandPool* pool = new BandPool(std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, MAX_BANDS) - 1);
+        return *pool;
+    }
+
+    int Threads() const { return threads; }
+
+    // Run band(0) .. band(count - 1), on this thread and whichever pool threads are idle
+    void Run(int count, const std::function<void(int)>& band)
+    {
+        if (count == 1 || threads == 0) {
+            for (int i = 0; i < count; i++) {
+                band(i);
+            }
+            return;
+        }
+        BandJob job { band, count };
+        {
+            std::lock_guard lock(mutex);
+            jobs.push_back(&job);
+        }
+        work_ready.notify_all();
+        int ran = Claim(job);
+
+        std::unique_lock lock(mutex);
+        auto queued = std::find(jobs.begin(), jobs.end(), &job);
+        if (queued != jobs.end()) {
+            jobs.erase(queued);
+        }
+        job.done += ran;
+        job.finished.wait(lock, [&job] { return job.done == job.count && job.helpers == 0; });
+    }
+
+private:
+    const int threads;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::deque<BandJob*> jobs;
+
+    explicit BandPool(int threads)
+        : threads(threads)
+    {
+        for (int i = 0; i < threads; i++) {
+            std::thread(&BandPool::Worker, this).detach();
+        }
+    }
+
+    // run unclaimed bands of job until there are none left; returns how many
+    static int Claim(BandJob& job)
+    {
+        int ran = 0;
+        for (int band; (band = job.next.fetch_add(1)) < job.count; ran++) {
+            job.run(band);
+        }
+        return ran;
+    }
+
+    void Worker()
+    {
+        std::unique_lock lock(mutex);
+        while (true) {
+            work_ready.wait(lock, [this] { return !jobs.empty(); });
+            BandJob* job = jobs.front();
+            if (job->next >= job->count) {
+                jobs.pop_front();
+                continue;
+            }
+            job->helpers++;
+            lock.unlock();
+            int ran = Claim(*job);
+            lock.lock();
+            job->done += ran;
+            job->helpers--;
+            // notified under the lock: the caller can't return and destroy the job before it's released
+            if (job->done == job->count && job->helpers == 0) {
+                job->finished.notify_all();
+            }
+        }
+    }
+};
+
+inline float lanczos_kernel(float x, int a)
+{
+    if (x == 0.0f) return 1.0f;
+    if (std::abs(x) >= a) return 0.0f;
+    x *= M_PI;
+    return (a * std::sin(x) * std::sin(x / a)) / (x * x);
+}
+
+}
+
+LanczosResampler::LanczosResampler(int src_w, int src_h, int tgt_w, int tgt_h, int channels, int a)
+    : src_w(src_w)
+    , src_h(src_h)
+    , tgt_w(tgt_w)
+    , tgt_h(tgt_h)
+    , channels(channels)
+    , columns(ComputeTaps(src_w, tgt_w, a))
+    , rows(ComputeTaps(src_h, tgt_h, a))
+{
+}
+
+// Same sample positions as the original 2D filter: the source coordinate is not pixel-centered
+// and taps past the border are clamped onto it. The 2D weight was the product of the two axes,
+// so normalizing each axis separately gives the same result. For downscales the kernel covers
+// a * scale source pixels on each side instead of a.
+LanczosResampler::Taps LanczosResampler::ComputeTaps(int src_size, int tgt_size, int a)
+{
+    const float scale = std::max(1.0f, static_cast<float>(src_size) / tgt_size);
+    const int radius = static_cast<int>(std::ceil(a * scale));
+    Taps taps;
+    taps.count = 2 * radius + 1;
+    taps.index.resize(tgt_size * taps.count);
+    taps.weight.resize(tgt_size * taps.count);
+
+    std::vector<float> weights(taps.count);
+    for (int o = 0; o < tgt_size; o++) {
+        float center = static_cast<float>(o * src_size) / tgt_size;
+        int base = static_cast<int>(center);
+        int32_t* index = &taps.index[o * taps.count];
+        int16_t* weight = &taps.weight[o * taps.count];
+
+        float sum = 0;
+        for (int t = 0; t < taps.count; t++) {
+            index[t] = std::clamp(base + t - radius, 0, src_size - 1);
+            weights[t] = lanczos_kernel((center - index[t]) / scale, a);
+            sum += weights[t];
+        }
+
+        // round to Q14 and put the rounding error on the largest tap so that flat areas stay flat
+        int total = 0;
+        int largest = 0;
+        for (int t = 0; t < taps.count; t++) {
+            weight[t] = static_cast<int16_t>(std::lround(weights[t] / sum * (1 << WEIGHT_BITS)));
+            total += weight[t];
+            if (weight[t] > weight[largest]) {
+                largest = t;
+            }
+        }
+        weight[largest] += (1 << WEIGHT_BITS) - total;
+    }
+    return taps;
+}
+
+void LanczosResampler::HorizontalPass(const uint8_t* src_row, int16_t* out) const
+{
+    constexpr int shift = WEIGHT_BITS - INTERMEDIATE_BITS;
+    constexpr int round = 1 << (shift - 1);
+    const int count = columns.count;
+
+    for (int x = 0; x < tgt_w; x++) {
+        const int32_t* index = &columns.index[x * count];
+        const int16_t* weight = &columns.weight[x * count];
+        if (channels == 4) {
+            int32_t b = round, g = round, r = round, alpha = round;
+            for (int t = 0; t < count; t++) {
+                const uint8_t* pixel = src_row + index[t] * 4;
+                b += pixel[0] * weight[t];
+                g += pixel[1] * weight[t];
+                r += pixel[2] * weight[t];
+                alpha += pixel[3] * weight[t];
+            }
+            out[x * 4] = static_cast<int16_t>(b >> shift);
+            out[x * 4 + 1] = static_cast<int16_t>(g >> shift);
+            out[x * 4 + 2] = static_cast<int16_t>(r >> shift);
+            out[x * 4 + 3] = static_cast<int16_t>(alpha >> shift);
+        } else if (channels == 3) {
+            int32_t r = round, g = round, b = round;
+            for (int t = 0; t < count; t++) {
+                const uint8_t* pixel = src_row + index[t] * 3;
+                r += pixel[0] * weight[t];
+                g += pixel[1] * weight[t];
+                b += pixel[2] * weight[t];
+            }
+            out[x * 3] = static_cast<int16_t>(r >> shift);
+            out[x * 3 + 1] = static_cast<int16_t>(g >> shift);
+            out[x * 3 + 2] = static_cast<int16_t>(b >> shift);
+        } else {
+            int32_t v = round;
+            for (int t = 0; t < count; t++) {
+                v += src_row[index[t]] * weight[t];
+            }
+            out[x] = static_cast<int16_t>(v >> shift);
+        }
+    }
+}
+
+// out[i] = sum of lines[t][i] * weights[t] over all taps, for one whole output row
+void LanczosResampler::VerticalPass(const int16_t* const* lines, const int16_t* weights, uint8_t* out) const
+{
+    constexpr int shift = WEIGHT_BITS + INTERMEDIATE_BITS;
+    constexpr int32_t round = 1 << (shift - 1);
+    const int count = rows.count;
+    const int n = tgt_w * channels;
+    int i = 0;
+
+#if defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        int32x4_t lo = vdupq_n_s32(round);
+        int32x4_t hi = vdupq_n_s32(round);
+        for (int t = 0; t < count; t++) {
+            int16x8_t v = vld1q_s16(lines[t] + i);
+            lo = vmlal_n_s16(lo, vget_low_s16(v), weights[t]);
+            hi = vmlal_n_s16(hi, vget_high_s16(v), weights[t]);
+        }
+        int16x8_t packed = vcombine_s16(vqmovn_s32(vshrq_n_s32(lo, shift)), vqmovn_s32(vshrq_n_s32(hi, shift)));
+        vst1_u8(out + i, vqmovun_s16(packed));
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = _mm_set1_epi32(round);
+        __m128i hi = _mm_set1_epi32(round);
+        for (int t = 0; t < count; t++) {
+            // ring rows start on a cache line, so the 8-sample loads are aligned
+            __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(lines[t] + i));
+            __m128i w = _mm_set1_epi16(weights[t]);
+            // low and high halves of the 16x16 products, interleaved back into 32-bit lanes
+            __m128i product_lo = _mm_mullo_epi16(v, w);
+            __m128i product_hi = _mm_mulhi_epi16(v, w);
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(product_lo, product_hi));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(product_lo, product_hi));
+        }
+        __m128i packed = _mm_packs_epi32(_mm_srai_epi32(lo, shift), _mm_srai_epi32(hi, shift));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(packed, packed));
+    }
+#endif
+
+    for (; i < n; i++) {
+        int32_t v = round;
+        for (int t = 0; t < count; t++) {
+            v += lines[t][i] * weights[t];
+        }
+        out[i] = static_cast<uint8_t>(std::clamp(v >> shift, 0, 255));
+    }
+}
+
+// Each output row needs count consecutive source rows and the window only moves down,
+// so source row s is filtered horizontally once into ring slot s % count.
+void LanczosResampler::ResizeBand(const RowSource& source, uint8_t* dst, size_t dst_stride, int y_begin, int y_end) const
+{
+    const int count = rows.count;
+    // whole cache lines per filtered row, so every ring row starts aligned
+    const size_t line_size = (static_cast<size_t>(tgt_w) * channels + 31) / 32 * 32;
+    PooledBuffer ring_buffer(line_size * count * sizeof(int16_t));
+    auto ring = reinterpret_cast<int16_t*>(ring_buffer.Get());
+    std::vector<int> ring_row(count, -1);
+    std::vector<const int16_t*> lines(count);
+
+    for (int y = y_begin; y < y_end; y++) {
+        const int32_t* index = &rows.index[y * count];
+        for (int t = 0; t < count; t++) {
+            int slot = index[t] % count;
+            int16_t* line = &ring[slot * line_size];
+            if (ring_row[slot] != index[t]) {
+                HorizontalPass(source(index[t]), line);
+                ring_row[slot] = index[t];
+            }
+            lines[t] = line;
+        }
+        VerticalPass(lines.data(), &rows.weight[y * count], dst + y * dst_stride);
+    }
+}
+
+void LanczosResampler::Resize(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride) const
+{
+    auto& pool = BandPool::GetInstance();
+    int bands = std::clamp(tgt_h / MIN_BAND_ROWS, 1, pool.Threads() + 1);
+
+    RowSource source = [src, src_stride](int y) { return src + y * src_stride; };
+    pool.Run(bands, [&](int band) {
+        ResizeBand(source, dst, dst_stride, tgt_h * band / bands, tgt_h * (band + 1) / bands);
+    });
+}
+
+void LanczosResampler::ResizeStreaming(const RowSource& source, uint8_t* dst, size_t dst_stride) const
+{
+    ResizeBand(source, dst, dst_stride, 0, tgt_h);
+}
+
+BoxReducer::BoxReducer(LanczosResampler::RowSource source, int src_w, int src_h, int channels, int levels)
+    : source(std::move(source))
+    , channels(channels)
+    , levels(levels)
+    , width(src_w >> levels)
+    , height(src_h >> levels)
+    , sums(static_cast<size_t>(width) * channels)
+    , row(sums.size())
+{
+}
+
+int BoxReducer::Levels(int src_size, int tgt_size)
+{
+    int levels = 0;
+    while (tgt_size > 0 && (src_size >> (levels + 1)) >= tgt_size) {
+        levels++;
+    }
+    return levels;
+}
+
+const uint8_t* BoxReducer::Row(int y)
+{
+    const int block = 1 << levels;
+    std::fill(sums.begin(), sums.end(), 0);
+    for (int sy = y * block; sy < (y + 1) * block; sy++) {
+        const uint8_t* src = source(sy);
+        uint32_t* sum = sums.data();
+        for (int x = 0; x < width; x++, sum += channels) {
+            for (int bx = 0; bx < block; bx++, src += channels) {
+                for (int c = 0; c < channels; c++) {
+                    sum[c] += src[c];
+                }
+            }
+        }
+    }
+
+    const int shift = 2 * levels;
+    const uint32_t round = (1u << shift) >> 1;
+    for (size_t i = 0; i < row.size(); i++) {
+        row[i] = static_cast<uint8_t>((sums[i] + round) >> shift);
+    }
+    return row.data();
+}
@@ -0,0 +1,76 @@
+#ifndef IMAGE_RESAMPLER_H
+#define IMAGE_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Separable Lanczos resampler for 8-bit gray, RGB or BGRA images. The tap positions
+// and weights for every output column and row are computed once per size pair,
+// both passes run in fixed point, and output rows are split into bands that
+// resize in parallel on a small pool of threads shared by all callers. When
+// shrinking, the kernel is stretched by the scale factor so that it still filters
+// out what the smaller image can't represent.
+class LanczosResampler {
+public:
+    LanczosResampler(int src_w, int src_h, int tgt_w, int tgt_h, int channels, int a = 3);
+
+    // Returns source row y (src_w * channels bytes), valid until the next call. Rows are
+    // requested in increasing order, each at most once; rows no tap needs are skipped.
+    using RowSource = std::function<const uint8_t*(int y)>;
+
+    // src holds src_h rows of src_w * channels bytes, dst tgt_h rows of tgt_w * channels bytes
+    void Resize(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride) const;
+
+    // Resize on the calling thread while pulling source rows one at a time, e.g. from a
+    // decoder; only a ring of 2a+1 filtered rows is kept besides dst.
+    void ResizeStreaming(const RowSource& source, uint8_t* dst, size_t dst_stride) const;
+
+private:
+    // weights are Q14 and sum to exactly 1 << WEIGHT_BITS for every output coordinate
+    static constexpr int WEIGHT_BITS = 14;
+    // the horizontal pass keeps this many fraction bits for the vertical pass
+    static constexpr int INTERMEDIATE_BITS = 6;
+
+    struct Taps {
+        int count = 0;
+        std::vector<int32_t> index; // count source coordinates per output coordinate
+        std::vector<int16_t> weight;
+    };
+
+    int src_w, src_h, tgt_w, tgt_h, channels;
+    Taps columns;
+    Taps rows;
+
+    static Taps ComputeTaps(int src_size, int tgt_size, int a);
+    void HorizontalPass(const uint8_t* src_row, int16_t* out) const;
+    void VerticalPass(const int16_t* const* lines, const int16_t* weights, uint8_t* out) const;
+    void ResizeBand(const RowSource& source, uint8_t* dst, size_t dst_stride, int y_begin, int y_end) const;
+};
+
+// Averages 2^levels x 2^levels blocks of a row stream: the same as that many levels of a 2x2
+// box pyramid, without rounding in between. Large reductions go through this first so that
+// the Lanczos pass only has to cover the last factor of less than two. Trailing rows and
+// columns that don't fill a whole block are dropped.
+class BoxReducer {
+public:
+    BoxReducer(LanczosResampler::RowSource source, int src_w, int src_h, int channels, int levels);
+
+    // Levels that bring src_size down to within 2x of tgt_size
+    static int Levels(int src_size, int tgt_size);
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    // Row y of the reduced image, valid until the next call; same ordering rules as RowSource
+    const uint8_t* Row(int y);
+
+private:
+    LanczosResampler::RowSource source;
+    int channels, levels, width, height;
+    std::vector<uint32_t> sums;
+    std::vector<uint8_t> row;
+};
+
+#endif // IMAGE_RESAMPLER_H
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only mmap of a whole file. Pages are faulted in straight from the page cache
+// instead of being copied out by many small read() calls; the mapping is advised as
+// sequential since books are mostly read front to back.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* filename);
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+    // Start reading [offset, offset + length) from disk in the background
+    void WillNeed(uint64_t offset, uint64_t length) const;
+
+private:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+#endif // MAPPED_FILE_H
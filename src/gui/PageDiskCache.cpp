@@ -0,0 +1,287 @@
+#include "PageDiskCache.h"
+#include "../constants.h"
+#include "../utils/stats.h"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t DEFAULT_QUOTA_MB = 256;
+constexpr uint32_t PAGE_MAGIC = 0x45474150; // "PAGE"
+constexpr uint32_t PAGE_VERSION = 1;
+constexpr const char* PAGE_SUFFIX = ".page";
+
+// followed by path_size bytes of archive path, zero padding up to 64 bytes, then the rows
+struct PageHeader {
+    uint32_t magic;
+    uint32_t version;
+    int64_t mtime;
+    uint32_t page;
+    uint32_t target_height;
+    uint32_t format; // requested
+    uint32_t pixel_format; // what the page came out as: gray pages are always L8
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t path_size;
+};
+
+size_t PixelsOffset(size_t path_size)
+{
+    return (sizeof(PageHeader) + path_size + ImagePool::ALIGNMENT - 1) / ImagePool::ALIGNMENT * ImagePool::ALIGNMENT;
+}
+
+int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool ReadAll(int fd, void* data, size_t size, off_t offset)
+{
+    auto bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t count = pread(fd, bytes, size, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+        offset += count;
+    }
+    return true;
+}
+
+bool WriteAll(int fd, const void* data, size_t size)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t count = write(fd, bytes, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool EndsWith(const std::string& s, const char* suffix)
+{
+    size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+}
+
+PageDiskCache& PageDiskCache::GetInstance()
+{
+    static PageDiskCache* instance = [] {
+        uint64_t quota_mb = DEFAULT_QUOTA_MB;
+        if (auto env = std::getenv(ENV_PAGE_CACHE_DISK_MB)) {
+            quota_mb = std::strtoull(env, nullptr, 10);
+        }
+        return new PageDiskCache(PAGE_CACHE_DIR, quota_mb * 1024 * 1024);
+    }();
+    return *instance;
+}
+
+PageDiskCache::PageDiskCache(std::string directory, uint64_t quota_bytes)
+    : directory(std::move(directory))
+    , quota_bytes(quota_bytes)
+{
+    if (mkdir(this->directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        spdlog::warn("Can't create page cache {}: {}", this->directory, strerror(errno));
+        return;
+    }
+
+    DIR* dir = opendir(this->directory.c_str());
+    if (!dir) {
+        return;
+    }
+    while (auto entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        std::string path = this->directory + name;
+        struct stat st;
+        if (EndsWith(name, PAGE_SUFFIX) && stat(path.c_str(), &st) == 0) {
+            files[name] = { static_cast<uint64_t>(st.st_size), st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec };
+            total_bytes += st.st_size;
+        } else if (name.find(".tmp") != std::string::npos) {
+            // left behind by a write that never finished
+            unlink(path.c_str());
+        }
+    }
+    closedir(dir);
+
+    std::lock_guard lock(mutex);
+    Evict();
+    spdlog::debug("Page cache {}: {} pages, {} of {} MB", this->directory, files.size(), total_bytes >> 20, quota_bytes >> 20);
+}
+
+// FNV-1a over every key field; the header in the file tells collisions apart
+std::string PageDiskCache::FileName(const Key& key)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+    };
+    uint32_t format = static_cast<uint32_t>(key.format);
+    mix(key.path.data(), key.path.size());
+    mix(&key.mtime, sizeof(key.mtime));
+    mix(&key.page, sizeof(key.page));
+    mix(&key.height, sizeof(key.height));
+    mix(&format, sizeof(format));
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(hash), PAGE_SUFFIX);
+    return name;
+}
+
+bool PageDiskCache::Load(const Key& key, Image& image)
+{
+    static auto& hits = stats::get("page_disk_cache.hits");
+    static auto& misses = stats::get("page_disk_cache.misses");
+
+    std::string name = FileName(key);
+    std::string path = directory + name;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        misses.add(1);
+        return false;
+    }
+
+    PageHeader header;
+    std::string page_path(key.path.size(), '\0');
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 && ReadAll(fd, &header, sizeof(header), 0)
+        && header.magic == PAGE_MAGIC && header.version == PAGE_VERSION && header.pixel_format <= static_cast<uint32_t>(PixelFormat::ARGB8888)
+        && header.mtime == key.mtime && header.page == key.page && header.target_height == key.height
+        && header.format == static_cast<uint32_t>(key.format) && header.path_size == key.path.size()
+        && ReadAll(fd, page_path.data(), page_path.size(), sizeof(header)) && page_path == key.path;
+
+    // check the dimensions against the file before allocating anything: pages are renamed into
+    // place whole, so a file that doesn't match its header was damaged by something else
+    size_t offset = PixelsOffset(header.path_size);
+    if (valid) {
+        auto pixel_format = static_cast<PixelFormat>(header.pixel_format);
+        uint64_t row_size = static_cast<uint64_t>(header.width) * BytesPerPixel(pixel_format);
+        uint64_t stride = (row_size + ImagePool::ALIGNMENT - 1) / ImagePool::ALIGNMENT * ImagePool::ALIGNMENT;
+        uint64_t pixels_size = static_cast<uint64_t>(st.st_size) - offset;
+        valid = header.width > 0 && header.height > 0 && header.width <= INT32_MAX && header.height <= INT32_MAX
+            && header.stride == stride && static_cast<uint64_t>(st.st_size) > offset
+            && pixels_size % stride == 0 && pixels_size / stride == header.height;
+    }
+
+    Image loaded;
+    if (valid) {
+        loaded.Allocate(header.width, header.height, static_cast<PixelFormat>(header.pixel_format));
+        valid = ReadAll(fd, loaded.Row(0), loaded.Size(), offset);
+    }
+    if (valid) {
+        futimens(fd, nullptr); // the file's mtime is its last use
+    }
+    close(fd);
+
+    if (!valid) {
+        // another key with the same hash, or a file from another version: it will be replaced
+        misses.add(1);
+        return false;
+    }
+    hits.add(1);
+    image = std::move(loaded);
+
+    std::lock_guard lock(mutex);
+    Touch(name, st.st_size);
+    return true;
+}
+
+void PageDiskCache::Store(const Key& key, const Image& image)
+{
+    static auto& writes = stats::get("page_disk_cache.writes");
+
+    size_t pixels_offset = PixelsOffset(key.path.size());
+    if (image.Empty() || pixels_offset + image.Size() > quota_bytes) {
+        return;
+    }
+
+    PageHeader header {};
+    header.magic = PAGE_MAGIC;
+    header.version = PAGE_VERSION;
+    header.mtime = key.mtime;
+    header.page = key.page;
+    header.target_height = key.height;
+    header.format = static_cast<uint32_t>(key.format);
+    header.pixel_format = static_cast<uint32_t>(image.format);
+    header.width = image.width;
+    header.height = image.height;
+    header.stride = image.stride;
+    header.path_size = key.path.size();
+    std::vector<uint8_t> head(pixels_offset);
+    std::memcpy(head.data(), &header, sizeof(header));
+    std::memcpy(head.data() + sizeof(header), key.path.data(), key.path.size());
+
+    // written under a private name and renamed, so readers only ever see complete pages
+    std::string name = FileName(key);
+    std::string temp_path = directory + name + ".tmp" + std::to_string(temp_counter++);
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        spdlog::warn("Can't write page cache file {}: {}", temp_path, strerror(errno));
+        return;
+    }
+    bool success = WriteAll(fd, head.data(), head.size()) && WriteAll(fd, image.Row(0), image.Size());
+    success = close(fd) == 0 && success && rename(temp_path.c_str(), (directory + name).c_str()) == 0;
+    if (!success) {
+        spdlog::warn("Can't write page cache file {}: {}", temp_path, strerror(errno));
+        unlink(temp_path.c_str());
+        return;
+    }
+    writes.add(1);
+
+    std::lock_guard lock(mutex);
+    Touch(name, pixels_offset + image.Size());
+    Evict();
+}
+
+void PageDiskCache::Touch(const std::string& name, uint64_t size)
+{
+    auto [it, inserted] = files.try_emplace(name, FileInfo { 0, 0 });
+    total_bytes = total_bytes - it->second.size + size;
+    it->second = { size, NowNs() };
+}
+
+// the index is a few dozen screen-sized pages, so a linear search for the oldest is fine
+void PageDiskCache::Evict()
+{
+    static auto& evictions = stats::get("page_disk_cache.evictions");
+
+    while (total_bytes > quota_bytes && !files.empty()) {
+        auto oldest = files.begin();
+        for (auto it = files.begin(); it != files.end(); ++it) {
+            if (it->second.last_used < oldest->second.last_used) {
+                oldest = it;
+            }
+        }
+        unlink((directory + oldest->first).c_str());
+        total_bytes -= oldest->second.size;
+        files.erase(oldest);
+        evictions.add(1);
+    }
+    stats::get("page_disk_cache.bytes").set(total_bytes);
+}
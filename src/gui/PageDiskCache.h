@@ -0,0 +1,55 @@
+#ifndef PAGE_DISK_CACHE_H
+#define PAGE_DISK_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include "ImageIo.h"
+
+// Pages already decoded and scaled for display, one raw file each under PAGE_CACHE_DIR,
+// so that reopening a book skips decompression, decode and resize. Files hold the pixels
+// with Image's 64-byte row layout and load with a single read. The directory is kept
+// under a byte quota by evicting the least recently used pages. Thread safe.
+class PageDiskCache {
+public:
+    struct Key {
+        std::string path; // archive
+        int64_t mtime;    // of the archive, so edited books miss
+        uint32_t page;
+        uint32_t height;
+        PixelFormat format;
+    };
+
+    static PageDiskCache& GetInstance();
+
+    PageDiskCache(const PageDiskCache&) = delete;
+    PageDiskCache& operator=(const PageDiskCache&) = delete;
+
+    // Fill image with the cached page; false on a miss
+    bool Load(const Key& key, Image& image);
+    // Write image as the page for key, evicting older pages to stay under the quota
+    void Store(const Key& key, const Image& image);
+
+private:
+    PageDiskCache(std::string directory, uint64_t quota_bytes);
+
+    struct FileInfo {
+        uint64_t size;
+        int64_t last_used; // ns since the epoch, the file's mtime
+    };
+
+    const std::string directory;
+    const uint64_t quota_bytes;
+    std::mutex mutex;
+    std::map<std::string, FileInfo> files; // by file name
+    uint64_t total_bytes = 0;
+    std::atomic<uint32_t> temp_counter { 0 };
+
+    static std::string FileName(const Key& key);
+    void Touch(const std::string& name, uint64_t size);
+    void Evict();
+};
+
+#endif // PAGE_DISK_CACHE_H
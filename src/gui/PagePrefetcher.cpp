@@ -0,0 +1,192 @@
+#include "PagePrefetcher.h"
+#include "PageDiskCache.h"
+#include "../utils/stats.h"
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+
+PagePrefetcher::PagePrefetcher(std::unique_ptr<ComicArchive> archive, uint32_t height, PixelFormat format,
+                               size_t budget_bytes, int workers)
+    : archive(std::move(archive))
+    , page_count(this->archive->GetImageCount())
+    , height(height)
+    , format(format)
+    , budget_bytes(budget_bytes)
+{
+    struct stat st;
+    if (stat(this->archive->GetFilename().c_str(), &st) == 0) {
+        archive_mtime = st.st_mtime;
+    }
+    for (int i = 0; i < workers; i++) {
+        threads.emplace_back(&PagePrefetcher::Worker, this);
+    }
+}
+
+PagePrefetcher::~PagePrefetcher()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    work_ready.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    stats::get("page_cache.bytes").add(-static_cast<int64_t>(cached_bytes));
+
+    // the book is closed: hand the page-sized buffers its pages and decodes leave in the pool back to the system
+    pages.clear();
+    ImagePool::Trim();
+}
+
+// the pages a reader turns to from current: forward two, back one
+bool PagePrefetcher::InWindow(uint32_t id) const
+{
+    return id == current || id == current + 1 || id == current + 2 || id + 1 == current;
+}
+
+std::shared_ptr<const Image> PagePrefetcher::Decode(uint32_t id)
+{
+    auto image = std::make_shared<Image>();
+    PageDiskCache::Key key { archive->GetFilename(), archive_mtime, id, height, format };
+    if (PageDiskCache::GetInstance().Load(key, *image)) {
+        return image;
+    }
+    try {
+        if (!archive->GetImage(id, height, *image, format)) {
+            return nullptr;
+        }
+    } catch (const std::bad_alloc&) {
+        // e.g. a corrupt page header announcing huge dimensions; must not escape a worker thread
+        spdlog::error("No memory to decode page {}", id);
+        return nullptr;
+    }
+    PageDiskCache::GetInstance().Store(key, *image);
+    return image;
+}
+
+std::shared_ptr<const Image> PagePrefetcher::Lookup(uint32_t id)
+{
+    auto it = pages.find(id);
+    if (it == pages.end()) {
+        return nullptr;
+    }
+    lru.splice(lru.begin(), lru, it->second.lru_position);
+    return it->second.image;
+}
+
+void PagePrefetcher::Insert(uint32_t id, std::shared_ptr<const Image> image)
+{
+    static auto& bytes = stats::get("page_cache.bytes");
+
+    size_t size = image->Size();
+    if (size > budget_bytes || pages.count(id)) {
+        return;
+    }
+    while (cached_bytes + size > budget_bytes && !lru.empty()) {
+        auto victim = pages.find(lru.back());
+        cached_bytes -= victim->second.image->Size();
+        bytes.add(-static_cast<int64_t>(victim->second.image->Size()));
+        pages.erase(victim);
+        lru.pop_back();
+    }
+    lru.push_front(id);
+    pages[id] = { std::move(image), lru.begin() };
+    cached_bytes += size;
+    bytes.add(size);
+}
+
+void PagePrefetcher::Schedule(uint32_t id)
+{
+    if (id < page_count && !pages.count(id) && !in_flight.count(id)
+        && std::find(queue.begin(), queue.end(), id) == queue.end()) {
+        queue.push_back(id);
+    }
+}
+
+std::shared_ptr<const Image> PagePrefetcher::GetPage(uint32_t id)
+{
+    static auto& hits = stats::get("page_cache.hits");
+    static auto& waits = stats::get("page_cache.waits");
+    static auto& misses = stats::get("page_cache.misses");
+    static auto& cancelled = stats::get("page_cache.cancelled");
+    static auto& turn_max = stats::get("page_cache.turn_us_max");
+
+    if (id >= page_count) {
+        return nullptr;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock lock(mutex);
+    current = id;
+
+    // queued pages the reader moved away from aren't worth decoding any more
+    size_t queued = queue.size();
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [this](uint32_t page) { return !InWindow(page); }), queue.end());
+    cancelled.add(queued - queue.size());
+    queue.erase(std::remove(queue.begin(), queue.end(), id), queue.end());
+    for (uint32_t next : { id + 1, id + 2, id - 1 }) {
+        Schedule(next);
+    }
+    if (!queue.empty()) {
+        work_ready.notify_all();
+    }
+
+    auto image = Lookup(id);
+    if (image) {
+        hits.add(1);
+    } else if (in_flight.count(id)) {
+        waits.add(1);
+        page_done.wait(lock, [this, id] { return !in_flight.count(id); });
+        image = Lookup(id);
+    }
+    if (!image) {
+        // not prefetched (or a worker failed on it): decode on this thread
+        misses.add(1);
+        in_flight.insert(id);
+        lock.unlock();
+        image = Decode(id);
+        lock.lock();
+        in_flight.erase(id);
+        if (image) {
+            Insert(id, image);
+        }
+        page_done.notify_all();
+    }
+
+    turn_max.update_max(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    return image;
+}
+
+void PagePrefetcher::Worker()
+{
+    static auto& prefetched = stats::get("page_cache.prefetched");
+
+    std::unique_lock lock(mutex);
+    while (true) {
+        work_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (stopping) {
+            return;
+        }
+        uint32_t id = queue.front();
+        queue.pop_front();
+        in_flight.insert(id);
+
+        lock.unlock();
+        auto image = Decode(id);
+        lock.lock();
+
+        in_flight.erase(id);
+        // a page the reader jumped away from while it was decoding isn't kept
+        if (image && InWindow(id)) {
+            Insert(id, std::move(image));
+            prefetched.add(1);
+        } else if (!image) {
+            spdlog::warn("Prefetching page {} failed", id);
+        }
+        page_done.notify_all();
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PAGE_PREFETCHER_H
+#define PAGE_PREFETCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ComicArchive.h"
+
+// Decoded, resized pages of one book kept in a byte-budgeted LRU. Every GetPage also
+// queues the pages a reader is likely to turn to next (N+1, N+2, N-1) for worker threads,
+// so a page turn usually finds its pixels ready. Jumping elsewhere drops the queued
+// pages that are no longer near the current one. Pages come from PageDiskCache when a
+// previous run already prepared them, and are stored there otherwise.
+class PagePrefetcher {
+public:
+    PagePrefetcher(std::unique_ptr<ComicArchive> archive, uint32_t height, PixelFormat format,
+                   size_t budget_bytes, int workers = 2);
+    ~PagePrefetcher();
+
+    PagePrefetcher(const PagePrefetcher&) = delete;
+    PagePrefetcher& operator=(const PagePrefetcher&) = delete;
+
+    uint32_t GetPageCount() const { return page_count; }
+
+    // Page id at the configured height and format; nullptr if it can't be decoded. Served
+    // from the cache, waits for a worker already decoding it, or decodes it right here.
+    std::shared_ptr<const Image> GetPage(uint32_t id);
+
+private:
+    struct CachedPage {
+        std::shared_ptr<const Image> image;
+        std::list<uint32_t>::iterator lru_position;
+    };
+
+    std::unique_ptr<ComicArchive> archive;
+    int64_t archive_mtime = 0;
+    const uint32_t page_count;
+    const uint32_t height;
+    const PixelFormat format;
+    const size_t budget_bytes;
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable page_done;
+    std::unordered_map<uint32_t, CachedPage> pages;
+    std::list<uint32_t> lru; // most recently used first
+    size_t cached_bytes = 0;
+    std::deque<uint32_t> queue;
+    std::set<uint32_t> in_flight;
+    uint32_t current = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    bool InWindow(uint32_t id) const;
+    std::shared_ptr<const Image> Decode(uint32_t id);
+    // mutex must be held for the rest
+    std::shared_ptr<const Image> Lookup(uint32_t id);
+    void Insert(uint32_t id, std::shared_ptr<const Image> image);
+    void Schedule(uint32_t id);
+    void Worker();
+};
+
+#endif // PAGE_PREFETCHER_H
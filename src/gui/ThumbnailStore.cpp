@@ -0,0 +1,294 @@
+#include "ThumbnailStore.h"
+#include "ImageCache.h"
+#include "../constants.h"
+#include "../utils/stats.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t FILE_MAGIC = 0x48544642; // "BFTH"
+constexpr uint32_t FILE_VERSION = 1;
+constexpr uint32_t RECORD_MAGIC = 0x43455254; // "TREC"
+// don't bother rewriting the file for less garbage than this
+constexpr size_t COMPACT_MIN_BYTES = 4 * 1024 * 1024;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t reserved[ImagePool::ALIGNMENT - 8];
+};
+static_assert(sizeof(FileHeader) == ImagePool::ALIGNMENT);
+
+// followed by key_size bytes of path, zero padding up to the next 64 bytes, then the pixels
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t key_size;
+    int64_t mtime;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t color_format;
+    uint32_t data_size;
+    uint32_t record_size; // header, key, padding and pixels; a multiple of 64
+};
+
+size_t AlignUp(size_t size)
+{
+    return (size + ImagePool::ALIGNMENT - 1) / ImagePool::ALIGNMENT * ImagePool::ALIGNMENT;
+}
+
+bool WriteAll(int fd, const void* data, size_t size, off_t offset)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+// Write one record at offset; returns its size, or 0 on failure
+size_t WriteRecord(int fd, off_t offset, const std::string& key, int64_t mtime, const lv_image_header_t& image, const void* pixels, size_t data_size)
+{
+    size_t pixels_offset = AlignUp(sizeof(RecordHeader) + key.size());
+    RecordHeader header {};
+    header.magic = RECORD_MAGIC;
+    header.key_size = key.size();
+    header.mtime = mtime;
+    header.width = image.w;
+    header.height = image.h;
+    header.stride = image.stride;
+    header.color_format = image.cf;
+    header.data_size = data_size;
+    header.record_size = pixels_offset + AlignUp(data_size);
+
+    std::vector<uint8_t> head(pixels_offset);
+    std::memcpy(head.data(), &header, sizeof(header));
+    std::memcpy(head.data() + sizeof(header), key.data(), key.size());
+    std::vector<uint8_t> padding(header.record_size - pixels_offset - data_size);
+
+    if (!WriteAll(fd, head.data(), head.size(), offset)
+        || !WriteAll(fd, pixels, data_size, offset + pixels_offset)
+        || !WriteAll(fd, padding.data(), padding.size(), offset + pixels_offset + data_size)) {
+        return 0;
+    }
+    return header.record_size;
+}
+
+}
+
+ThumbnailStore& ThumbnailStore::GetInstance()
+{
+    // mappings must outlive every lv_image showing a thumbnail, so the store is never destroyed
+    static ThumbnailStore* instance = new ThumbnailStore(THUMBNAIL_STORE_FILE);
+    return *instance;
+}
+
+ThumbnailStore::ThumbnailStore(std::string filename)
+    : filename(std::move(filename))
+{
+    if (mkdir(THUMBNAIL_DIR, 0755) != 0 && errno != EEXIST) {
+        spdlog::warn("Can't create {}: {}", THUMBNAIL_DIR, strerror(errno));
+    }
+    Open();
+    Compact();
+}
+
+void ThumbnailStore::Open()
+{
+    fd = open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        spdlog::error("Can't open thumbnail store {}: {}", filename, strerror(errno));
+        return;
+    }
+
+    FileHeader header {};
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+        // new file, or one written by another version: start over
+        header = {};
+        header.magic = FILE_MAGIC;
+        header.version = FILE_VERSION;
+        if (ftruncate(fd, 0) != 0 || !WriteAll(fd, &header, sizeof(header), 0)) {
+            spdlog::error("Can't initialize thumbnail store {}: {}", filename, strerror(errno));
+            close(fd);
+            fd = -1;
+            return;
+        }
+    }
+    mapped_size = sizeof(FileHeader);
+    Refresh();
+
+    // drop a record torn by a crash so that appends start on a record boundary again
+    struct stat st;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > mapped_size) {
+        spdlog::warn("Thumbnail store {}: dropping {} bytes of incomplete records", filename, st.st_size - mapped_size);
+        if (ftruncate(fd, mapped_size) != 0) {
+            spdlog::error("Can't truncate thumbnail store {}: {}", filename, strerror(errno));
+        }
+    }
+    spdlog::debug("Thumbnail store {}: {} thumbnails, {} bytes", filename, entries.size(), mapped_size);
+}
+
+void ThumbnailStore::Refresh()
+{
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= mapped_size) {
+        return;
+    }
+
+    // map only what was added since the last refresh, starting on a page boundary
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t map_offset = mapped_size / page_size * page_size;
+    size_t map_size = st.st_size - map_offset;
+    void* data = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, map_offset);
+    if (data == MAP_FAILED) {
+        spdlog::error("Can't map thumbnail store {}: {}", filename, strerror(errno));
+        return;
+    }
+    mappings.push_back({ static_cast<const uint8_t*>(data), map_size });
+    mapped_size = Scan(mappings.back(), map_offset, mapped_size);
+    stats::get("thumbnail_store.mapped_bytes").set(mapped_size);
+}
+
+// Index the records in mapping (file bytes from map_offset on) starting at file offset begin.
+// Returns the offset just past the last complete record.
+size_t ThumbnailStore::Scan(const Mapping& mapping, size_t map_offset, size_t begin)
+{
+    size_t offset = begin;
+    size_t end = map_offset + mapping.size;
+    while (offset + sizeof(RecordHeader) <= end) {
+        const uint8_t* record = mapping.data + (offset - map_offset);
+        RecordHeader header;
+        std::memcpy(&header, record, sizeof(header));
+        size_t pixels_offset = AlignUp(sizeof(RecordHeader) + header.key_size);
+        if (header.magic != RECORD_MAGIC || header.record_size % ImagePool::ALIGNMENT != 0
+            || header.record_size < pixels_offset + header.data_size || header.record_size > end - offset) {
+            break;
+        }
+
+        // later records replace earlier ones for the same book
+        std::string key(reinterpret_cast<const char*>(record + sizeof(RecordHeader)), header.key_size);
+        Entry& entry = entries[key];
+        entry.mtime = header.mtime;
+        entry.record_size = header.record_size;
+        entry.dsc = {};
+        entry.dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+        entry.dsc.header.w = header.width;
+        entry.dsc.header.h = header.height;
+        entry.dsc.header.stride = header.stride;
+        entry.dsc.header.cf = header.color_format;
+        entry.dsc.data_size = header.data_size;
+        entry.dsc.data = record + pixels_offset;
+        offset += header.record_size;
+    }
+    return offset;
+}
+
+const lv_image_dsc_t* ThumbnailStore::Find(const std::string& path, int64_t mtime) const
+{
+    static auto& hits = stats::get("thumbnail_store.hits");
+    static auto& misses = stats::get("thumbnail_store.misses");
+
+    auto it = entries.find(path);
+    if (it == entries.end() || it->second.mtime != mtime) {
+        misses.add(1);
+        return nullptr;
+    }
+    hits.add(1);
+    return &it->second.dsc;
+}
+
+bool ThumbnailStore::Add(const std::string& path, int64_t mtime, const Image& image)
+{
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        return false;
+    }
+
+    lv_image_header_t header {};
+    header.w = image.width;
+    header.h = image.height;
+    header.stride = image.stride;
+    header.cf = ToLvColorFormat(image.format);
+    if (WriteRecord(fd, st.st_size, path, mtime, header, image.Row(0), image.Size()) == 0) {
+        spdlog::error("Can't write thumbnail for {} to {}: {}", path, filename, strerror(errno));
+        // keep the file ending on a record boundary
+        if (ftruncate(fd, st.st_size) != 0) {
+            spdlog::error("Can't truncate thumbnail store {}: {}", filename, strerror(errno));
+        }
+        return false;
+    }
+    return true;
+}
+
+// Rewrite the file with only the current record of each book that still exists, once
+// replaced and orphaned records take up more space than the live ones. Only runs before
+// anything points into the mappings.
+void ThumbnailStore::Compact()
+{
+    if (fd < 0) {
+        return;
+    }
+
+    size_t live_bytes = 0;
+    std::vector<const std::string*> live;
+    for (const auto& [path, entry] : entries) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            live_bytes += entry.record_size;
+            live.push_back(&path);
+        }
+    }
+    size_t dead_bytes = mapped_size - sizeof(FileHeader) - live_bytes;
+    if (dead_bytes < COMPACT_MIN_BYTES || dead_bytes < live_bytes) {
+        return;
+    }
+
+    spdlog::info("Compacting thumbnail store {}: {} of {} bytes are stale", filename, dead_bytes, mapped_size);
+    std::string temp_filename = filename + ".tmp";
+    int temp_fd = open(temp_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool success = temp_fd >= 0;
+    FileHeader file_header {};
+    file_header.magic = FILE_MAGIC;
+    file_header.version = FILE_VERSION;
+    off_t offset = sizeof(file_header);
+    success = success && WriteAll(temp_fd, &file_header, sizeof(file_header), 0);
+    for (size_t i = 0; success && i < live.size(); i++) {
+        const Entry& entry = entries.at(*live[i]);
+        size_t written = WriteRecord(temp_fd, offset, *live[i], entry.mtime, entry.dsc.header, entry.dsc.data, entry.dsc.data_size);
+        success = written != 0;
+        offset += written;
+    }
+    success = success && fsync(temp_fd) == 0 && rename(temp_filename.c_str(), filename.c_str()) == 0;
+    if (temp_fd >= 0) {
+        close(temp_fd);
+    }
+    if (!success) {
+        spdlog::error("Can't compact thumbnail store {}: {}", filename, strerror(errno));
+        unlink(temp_filename.c_str());
+        return;
+    }
+
+    entries.clear();
+    for (const auto& mapping : mappings) {
+        munmap(const_cast<uint8_t*>(mapping.data), mapping.size);
+    }
+    mappings.clear();
+    close(fd);
+    Open();
+}
@@ -0,0 +1,60 @@
+#ifndef THUMBNAIL_STORE_H
+#define THUMBNAIL_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lvgl_renderer.h"
+#include "ImageIo.h"
+
+// All book thumbnails in one append-only file, keyed by book path and modification
+// time. Pixels are stored in their LVGL color format with 64-byte aligned rows and
+// the file is mmap'ed, so a stored thumbnail is an lv_image_dsc_t pointing into the
+// mapping: showing it takes no read or decode. LVGL thread only.
+class ThumbnailStore {
+public:
+    static ThumbnailStore& GetInstance();
+
+    ThumbnailStore(const ThumbnailStore&) = delete;
+    ThumbnailStore& operator=(const ThumbnailStore&) = delete;
+
+    // Map thumbnails appended since the last call; cheap when nothing changed
+    void Refresh();
+
+    // The thumbnail for path if one was stored for this mtime and is mapped, else nullptr.
+    // The descriptor stays valid for the life of the process.
+    const lv_image_dsc_t* Find(const std::string& path, int64_t mtime) const;
+
+    // Append image as the thumbnail for path; it becomes visible to Find after Refresh
+    bool Add(const std::string& path, int64_t mtime, const Image& image);
+
+private:
+    explicit ThumbnailStore(std::string filename);
+    ~ThumbnailStore() = default;
+
+    struct Entry {
+        int64_t mtime;
+        size_t record_size;
+        lv_image_dsc_t dsc;
+    };
+
+    struct Mapping {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    std::string filename;
+    int fd = -1;
+    std::unordered_map<std::string, Entry> entries;
+    // lv_images on screen may point into any of these, so they are only unmapped by
+    // the compaction that runs before the first lookup
+    std::vector<Mapping> mappings;
+    size_t mapped_size = 0; // file bytes indexed so far
+
+    void Open();
+    void Compact();
+    size_t Scan(const Mapping& mapping, size_t map_offset, size_t begin);
+};
+
+#endif // THUMBNAIL_STORE_H
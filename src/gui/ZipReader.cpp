@@ -0,0 +1,228 @@
+#include "ZipReader.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <spdlog/spdlog.h>
+#include <zlib.h>
+
+namespace {
+
+constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+constexpr uint32_t END_OF_DIRECTORY_SIGNATURE = 0x06054b50;
+constexpr uint32_t ZIP64_END_OF_DIRECTORY_SIGNATURE = 0x06064b50;
+constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+constexpr uint16_t ZIP64_EXTRA_ID = 0x0001;
+
+constexpr size_t LOCAL_HEADER_SIZE = 30;
+constexpr size_t CENTRAL_HEADER_SIZE = 46;
+constexpr size_t END_OF_DIRECTORY_SIZE = 22;
+constexpr size_t ZIP64_END_OF_DIRECTORY_SIZE = 56;
+constexpr size_t ZIP64_LOCATOR_SIZE = 20;
+constexpr size_t MAX_COMMENT_SIZE = 0xffff;
+
+constexpr uint16_t METHOD_STORED = 0;
+constexpr uint16_t METHOD_DEFLATED = 8;
+constexpr uint16_t FLAG_ENCRYPTED = 1;
+// deflate can't expand data more than this, so a larger size is a lie
+constexpr uint64_t MAX_DEFLATE_RATIO = 1032;
+
+// ZIP fields are little endian whatever the host is
+uint16_t Read16(const uint8_t* p)
+{
+    return p[0] | p[1] << 8;
+}
+
+uint32_t Read32(const uint8_t* p)
+{
+    return Read16(p) | static_cast<uint32_t>(Read16(p + 2)) << 16;
+}
+
+uint64_t Read64(const uint8_t* p)
+{
+    return Read32(p) | static_cast<uint64_t>(Read32(p + 4)) << 32;
+}
+
+}
+
+bool ZipReader::Open(const uint8_t* data, size_t size, const char* filename)
+{
+    this->data = data;
+    file_size = size;
+    if (file_size < END_OF_DIRECTORY_SIZE) {
+        return false;
+    }
+
+    // the end of central directory record sits at the very end, before an optional comment
+    size_t tail_size = std::min<uint64_t>(file_size, END_OF_DIRECTORY_SIZE + MAX_COMMENT_SIZE);
+    const uint8_t* tail = data + file_size - tail_size;
+    size_t eocd = tail_size - END_OF_DIRECTORY_SIZE;
+    while (Read32(&tail[eocd]) != END_OF_DIRECTORY_SIGNATURE) {
+        if (eocd == 0) {
+            return false;
+        }
+        eocd--;
+    }
+
+    uint64_t count = Read16(&tail[eocd + 10]);
+    uint64_t directory_size = Read32(&tail[eocd + 12]);
+    uint64_t directory_offset = Read32(&tail[eocd + 16]);
+    if (count == 0xffff || directory_size == 0xffffffff || directory_offset == 0xffffffff) {
+        // ZIP64: the real values are in a second record, found through the locator before this one
+        uint64_t eocd_offset = file_size - tail_size + eocd;
+        const uint8_t* record = nullptr;
+        if (eocd_offset >= ZIP64_LOCATOR_SIZE) {
+            const uint8_t* locator = data + eocd_offset - ZIP64_LOCATOR_SIZE;
+            uint64_t record_offset = Read64(locator + 8);
+            if (Read32(locator) == ZIP64_LOCATOR_SIGNATURE && file_size >= ZIP64_END_OF_DIRECTORY_SIZE
+                && record_offset <= file_size - ZIP64_END_OF_DIRECTORY_SIZE) {
+                record = data + record_offset;
+            }
+        }
+        if (!record || Read32(record) != ZIP64_END_OF_DIRECTORY_SIGNATURE) {
+            spdlog::error("{}: ZIP64 end of central directory not found", filename);
+            return false;
+        }
+        count = Read64(record + 32);
+        directory_size = Read64(record + 40);
+        directory_offset = Read64(record + 48);
+    }
+
+    if (!ReadCentralDirectory(directory_offset, directory_size, count)) {
+        spdlog::error("{}: corrupt ZIP central directory", filename);
+        entries.clear();
+        return false;
+    }
+    spdlog::debug("{}: {} ZIP entries", filename, entries.size());
+    return true;
+}
+
+bool ZipReader::ReadCentralDirectory(uint64_t offset, uint64_t size, uint64_t count)
+{
+    if (offset > file_size || size > file_size - offset || count > size / CENTRAL_HEADER_SIZE) {
+        return false;
+    }
+    entries.reserve(count);
+    const uint8_t* p = data + offset;
+    const uint8_t* end = p + size;
+    for (uint64_t i = 0; i < count; i++) {
+        if (end - p < static_cast<ptrdiff_t>(CENTRAL_HEADER_SIZE) || Read32(p) != CENTRAL_HEADER_SIGNATURE) {
+            return false;
+        }
+        size_t name_size = Read16(p + 28);
+        size_t extra_size = Read16(p + 30);
+        size_t comment_size = Read16(p + 32);
+        size_t header_size = CENTRAL_HEADER_SIZE + name_size + extra_size + comment_size;
+        if (static_cast<size_t>(end - p) < header_size) {
+            return false;
+        }
+
+        Entry entry;
+        entry.flags = Read16(p + 8);
+        entry.method = Read16(p + 10);
+        entry.crc = Read32(p + 16);
+        entry.compressed_size = Read32(p + 20);
+        entry.size = Read32(p + 24);
+        entry.local_header_offset = Read32(p + 42);
+        entry.name.assign(reinterpret_cast<const char*>(p + CENTRAL_HEADER_SIZE), name_size);
+
+        // ZIP64 extra field: 64-bit values for exactly the fields saturated above, in this order
+        const uint8_t* extra = p + CENTRAL_HEADER_SIZE + name_size;
+        const uint8_t* extra_end = extra + extra_size;
+        while (extra_end - extra >= 4) {
+            uint16_t id = Read16(extra);
+            size_t field_size = Read16(extra + 2);
+            const uint8_t* field = extra + 4;
+            if (static_cast<size_t>(extra_end - field) < field_size) {
+                break;
+            }
+            if (id == ZIP64_EXTRA_ID) {
+                const uint8_t* field_end = field + field_size;
+                for (uint64_t* value : { &entry.size, &entry.compressed_size, &entry.local_header_offset }) {
+                    if (*value == 0xffffffff && field_end - field >= 8) {
+                        *value = Read64(field);
+                        field += 8;
+                    }
+                }
+            }
+            extra += 4 + field_size;
+        }
+
+        entries.push_back(std::move(entry));
+        p += header_size;
+    }
+    return true;
+}
+
+bool ZipReader::CanRead(const Entry& entry)
+{
+    return !(entry.flags & FLAG_ENCRYPTED) && (entry.method == METHOD_STORED || entry.method == METHOD_DEFLATED);
+}
+
+uint64_t ZipReader::DataOffset(const Entry& entry) const
+{
+    // the local header repeats the name and may carry a different extra field, so only its sizes matter
+    if (entry.local_header_offset > file_size - LOCAL_HEADER_SIZE) {
+        return 0;
+    }
+    const uint8_t* local = data + entry.local_header_offset;
+    if (Read32(local) != LOCAL_HEADER_SIGNATURE) {
+        return 0;
+    }
+    uint64_t data_offset = entry.local_header_offset + LOCAL_HEADER_SIZE + Read16(local + 26) + Read16(local + 28);
+    if (data_offset > file_size || entry.compressed_size > file_size - data_offset) {
+        return 0;
+    }
+    return data_offset;
+}
+
+const uint8_t* ZipReader::Read(const Entry& entry, PooledBuffer& scratch) const
+{
+    constexpr uint64_t max_size = std::numeric_limits<uInt>::max();
+    if (!CanRead(entry) || entry.size == 0 || entry.size > max_size || entry.compressed_size > max_size
+        || entry.size / MAX_DEFLATE_RATIO > entry.compressed_size) {
+        spdlog::error("Unsupported ZIP entry {} (method {}, flags {:#x})", entry.name, entry.method, entry.flags);
+        return nullptr;
+    }
+    uint64_t data_offset = DataOffset(entry);
+    if (data_offset == 0) {
+        spdlog::error("Bad local header for ZIP entry {}", entry.name);
+        return nullptr;
+    }
+
+    const uint8_t* result = nullptr;
+    if (entry.method == METHOD_STORED) {
+        if (entry.compressed_size == entry.size) {
+            result = data + data_offset;
+        }
+    } else {
+        try {
+            scratch = PooledBuffer(entry.size);
+        } catch (const std::bad_alloc&) {
+            spdlog::error("No memory to inflate ZIP entry {} ({} bytes)", entry.name, entry.size);
+            return nullptr;
+        }
+        z_stream stream {};
+        if (inflateInit2(&stream, -MAX_WBITS) == Z_OK) {
+            // zlib doesn't write through next_in
+            stream.next_in = const_cast<Bytef*>(data + data_offset);
+            stream.avail_in = entry.compressed_size;
+            stream.next_out = scratch.Get();
+            stream.avail_out = entry.size;
+            if (inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out == entry.size) {
+                result = scratch.Get();
+            }
+            inflateEnd(&stream);
+        }
+    }
+
+    if (result && crc32(0, result, entry.size) != entry.crc) {
+        spdlog::error("CRC mismatch in ZIP entry {}", entry.name);
+        result = nullptr;
+    }
+    if (!result) {
+        spdlog::error("Failed to read ZIP entry {}", entry.name);
+    }
+    return result;
+}
@@ -0,0 +1,49 @@
+#ifndef ZIP_READER_H
+#define ZIP_READER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ImageBuffer.h"
+
+// Random access to the members of a ZIP (CBZ) file in memory, usually a MappedFile,
+// through its central directory: reaching an entry costs the same however far into
+// the file it is. Stored entries are handed out in place, deflated ones are inflated.
+// Handles ZIP64. Read is thread safe.
+class ZipReader {
+public:
+    struct Entry {
+        std::string name;
+        uint64_t local_header_offset = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        uint32_t crc = 0;
+        uint16_t method = 0;
+        uint16_t flags = 0;
+    };
+
+    // Read the central directory of the size bytes at data, which must outlive the reader.
+    // False if they aren't a ZIP; name is only for messages.
+    bool Open(const uint8_t* data, size_t size, const char* name);
+
+    const std::vector<Entry>& Entries() const { return entries; }
+
+    // Whether Read supports the entry's compression method (no encryption)
+    static bool CanRead(const Entry& entry);
+
+    // Offset of the entry's data, past its local header; 0 if the header is broken
+    uint64_t DataOffset(const Entry& entry) const;
+
+    // The entry's entry.size bytes after a CRC check, or nullptr. Stored entries point
+    // into the ZIP data; deflated ones are inflated into scratch.
+    const uint8_t* Read(const Entry& entry, PooledBuffer& scratch) const;
+
+private:
+    const uint8_t* data = nullptr;
+    uint64_t file_size = 0;
+    std::vector<Entry> entries;
+
+    bool ReadCentralDirectory(uint64_t offset, uint64_t size, uint64_t count);
+};
+
+#endif // ZIP_READER_H
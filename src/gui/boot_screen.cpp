@@ -18,8 +18,7 @@ void boot_screen::start() {
     lvgl_renderer_inst->set_global_refresh_hint(MONOCHROME);
 
     /*
-    {
-        std::lock_guard lock(g_lvgl_mutex);
+    g_ui_tasks.run([] {
         spdlog::debug("Creating message box");
         auto msg_box = new message_box(lv_layer_top());
         msg_box->add_title("Welcome to Bifrost");
@@ -28,17 +27,21 @@ void boot_screen::start() {
         msg_box->show(300, 200);
         lv_obj_set_size(msg_box->msgbox, LV_PCT(80), LV_PCT(30));
         spdlog::debug("Message box created");
-    }
+    });
 
     // msg_box.add_button("OK", [] {});
     // msg_box.add_button("Cancel", [] {});
     std::this_thread::sleep_for(std::chrono::milliseconds(5000000));
     */
-    // setup_animation();
+    // g_ui_tasks.run([this] { setup_animation(); });
     // std::this_thread::sleep_for(std::chrono::milliseconds(5000));
 
     lvgl_renderer_inst->set_global_refresh_hint(MONOCHROME);
-    setup_boot_selection();
+    g_ui_tasks.run([this] {
+        // the boot screen is black and white only
+        lvgl_renderer_inst->set_color_format(LV_COLOR_FORMAT_L8);
+        setup_boot_selection();
+    });
 
     // wait for the user to select an option
     std::unique_lock lk(cv_m);
@@ -49,17 +52,17 @@ void boot_screen::start() {
 }
 
 boot_screen::~boot_screen() {
-    std::lock_guard lock(g_lvgl_mutex);
-    while (!deletion_queue.empty()) {
-        lv_obj_delete(deletion_queue.top());
-        deletion_queue.pop();
-    }
+    g_ui_tasks.run([this] {
+        while (!deletion_queue.empty()) {
+            lv_obj_delete(deletion_queue.top());
+            deletion_queue.pop();
+        }
+        lvgl_renderer_inst->set_color_format(LV_COLOR_FORMAT_ARGB8888);
+    });
     spdlog::debug("Boot screen deleted");
 }
 
 void boot_screen::setup_animation() {
-    std::lock_guard lock(g_lvgl_mutex);
-
     welcome_json = get_resource_file("animations/hello.json");
 
     lottie_obj = lv_lottie_create(lv_layer_top());
@@ -109,8 +112,6 @@ lv_obj_t *boot_screen::create_boot_option(const char *title) {
 }
 
 void boot_screen::setup_boot_selection() {
-    std::lock_guard lock(g_lvgl_mutex);
-
     auto remarkable = create_boot_option("reMarkable OS");
     lv_obj_align(remarkable, LV_ALIGN_BOTTOM_MID, 0, -425);
 
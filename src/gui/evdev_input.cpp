@@ -0,0 +1,220 @@
+#include "evdev_input.h"
+
+#include "../utils/stats.h"
+#include "../utils/ui_task_queue.h"
+
+#include <fcntl.h>
+#include <linux/input.h>
+#include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace {
+
+// same mapping as lv_evdev: scale the raw range onto the display and clamp
+int32_t calibrate(int32_t value, int32_t in_max, int32_t out_max)
+{
+    if (in_max > 0) {
+        value = static_cast<int64_t>(value) * out_max / in_max;
+    }
+    return std::clamp(value, 0, out_max);
+}
+
+std::chrono::steady_clock::time_point to_time_point(const timeval& time)
+{
+    // the devices are switched to CLOCK_MONOTONIC, which is what steady_clock uses on Linux
+    return std::chrono::steady_clock::time_point(std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec));
+}
+
+}
+
+evdev_input::evdev_input(lv_display_t* display)
+    : display(display)
+    , display_width(lv_display_get_horizontal_resolution(display))
+    , display_height(lv_display_get_vertical_resolution(display))
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+evdev_input::~evdev_input()
+{
+    stop();
+    for (auto& d : devices) {
+        close(d->fd);
+    }
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+bool evdev_input::add_pointer(const char* path, int32_t max_x, int32_t max_y)
+{
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        spdlog::error("Failed to open input device {}", path);
+        return false;
+    }
+
+    int clock = CLOCK_MONOTONIC;
+    if (ioctl(fd, EVIOCSCLOCKID, &clock) < 0) {
+        spdlog::warn("{} does not support monotonic timestamps; latency stats will be off", path);
+    }
+
+    auto d = std::make_unique<device>();
+    d->fd = fd;
+    d->path = path;
+    d->max_x = max_x;
+    d->max_y = max_y;
+    d->current.state = LV_INDEV_STATE_RELEASED;
+
+    d->indev = lv_indev_create();
+    lv_indev_set_type(d->indev, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(d->indev, read_cb);
+    lv_indev_set_user_data(d->indev, d.get());
+    lv_indev_set_display(d->indev, display);
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.ptr = d.get();
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+    devices.push_back(std::move(d));
+    return true;
+}
+
+void evdev_input::start()
+{
+    running = true;
+    thread = std::thread(&evdev_input::run, this);
+}
+
+void evdev_input::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    uint64_t one = 1;
+    write(wake_fd, &one, sizeof(one));
+    thread.join();
+}
+
+void evdev_input::run()
+{
+    epoll_event events[8];
+    while (running) {
+        int count = epoll_wait(epoll_fd, events, 8, -1);
+        for (int i = 0; i < count; i++) {
+            if (!events[i].data.ptr) {
+                return;
+            }
+            read_events(*static_cast<device*>(events[i].data.ptr));
+        }
+    }
+}
+
+void evdev_input::read_events(device& d)
+{
+    input_event events[64];
+    ssize_t bytes;
+    while ((bytes = read(d.fd, events, sizeof(events))) > 0) {
+        for (size_t i = 0; i < bytes / sizeof(input_event); i++) {
+            const auto& e = events[i];
+            switch (e.type) {
+            case EV_ABS:
+                if (e.code == ABS_X || e.code == ABS_MT_POSITION_X) {
+                    d.raw_x = e.value;
+                } else if (e.code == ABS_Y || e.code == ABS_MT_POSITION_Y) {
+                    d.raw_y = e.value;
+                } else if (e.code == ABS_MT_TRACKING_ID) {
+                    d.pressed = e.value >= 0;
+                }
+                break;
+            case EV_KEY:
+                if (e.code == BTN_TOUCH) {
+                    d.pressed = e.value != 0;
+                }
+                break;
+            case EV_SYN:
+                if (e.code == SYN_REPORT) {
+                    queue_sample(d, to_time_point(e.time));
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+void evdev_input::queue_sample(device& d, std::chrono::steady_clock::time_point time)
+{
+    static auto& samples = stats::get("input.samples");
+    static auto& coalesced = stats::get("input.coalesced");
+
+    sample s;
+    s.point.x = calibrate(d.raw_x, d.max_x, display_width - 1);
+    s.point.y = calibrate(d.raw_y, d.max_y, display_height - 1);
+    s.state = d.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    s.time = time;
+    samples.add(1);
+
+    {
+        std::lock_guard lock(d.mutex);
+        // a queued motion sample can be replaced by a newer one; an edge (state change) never is
+        auto state_before = [&d](size_t i) { return i == 0 ? d.current.state : d.pending[i - 1].state; };
+        size_t count = d.pending.size();
+        bool is_motion = s.state == state_before(count);
+        if (is_motion && count > 0 && d.pending.back().state == state_before(count - 1)) {
+            d.pending.back() = s;
+            coalesced.add(1);
+        } else if (count >= MAX_PENDING) {
+            // full: motion waits for the next sample, an edge takes the place of the newest motion
+            coalesced.add(1);
+            size_t i = count;
+            while (!is_motion && i-- > 0) {
+                if (d.pending[i].state == state_before(i)) {
+                    d.pending.erase(d.pending.begin() + i);
+                    d.pending.push_back(s);
+                    break;
+                }
+            }
+        } else {
+            d.pending.push_back(s);
+        }
+    }
+
+    // one queued read per device is enough; it drains everything pending
+    if (!d.read_queued.exchange(true)) {
+        g_ui_tasks.post([&d] {
+            d.read_queued = false;
+            lv_indev_read(d.indev);
+        });
+    }
+}
+
+void evdev_input::read_cb(lv_indev_t* indev, lv_indev_data_t* data)
+{
+    static auto& latency_max = stats::get("input.latency_us_max");
+
+    auto& d = *static_cast<device*>(lv_indev_get_user_data(indev));
+    std::lock_guard lock(d.mutex);
+    if (!d.pending.empty()) {
+        d.current = d.pending.front();
+        d.pending.pop_front();
+        latency_max.update_max(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - d.current.time).count());
+    }
+
+    data->point = d.current.point;
+    data->state = d.current.state;
+    // let lvgl see every queued edge within this read
+    data->continue_reading = !d.pending.empty();
+}
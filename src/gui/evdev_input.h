@@ -0,0 +1,79 @@
+#ifndef EVDEV_INPUT_H
+#define EVDEV_INPUT_H
+
+#include "lv_conf.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <lvgl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads evdev pointer devices on its own epoll thread and hands the samples to
+// lvgl through custom indevs. Motion is coalesced between UI ticks while every
+// press and release edge is kept, and each new sample schedules an immediate
+// read on the UI thread instead of waiting for lvgl's indev timer.
+class evdev_input {
+public:
+    explicit evdev_input(lv_display_t* display);
+    ~evdev_input();
+
+    evdev_input(const evdev_input&) = delete;
+    evdev_input& operator=(const evdev_input&) = delete;
+
+    // Open a pointer device whose raw axes span 0..max_x and 0..max_y. LVGL thread, before start().
+    bool add_pointer(const char* path, int32_t max_x, int32_t max_y);
+
+    void start();
+    void stop();
+
+private:
+    struct sample {
+        lv_point_t point;
+        lv_indev_state_t state;
+        // kernel timestamp of the SYN_REPORT that completed the sample
+        std::chrono::steady_clock::time_point time;
+    };
+
+    struct device {
+        int fd = -1;
+        std::string path;
+        int32_t max_x = 0;
+        int32_t max_y = 0;
+        lv_indev_t* indev = nullptr;
+
+        // assembled from the events of the current frame; input thread only
+        int32_t raw_x = 0;
+        int32_t raw_y = 0;
+        bool pressed = false;
+
+        std::mutex mutex;
+        std::deque<sample> pending;
+        // the sample lvgl saw last; repeated while nothing new arrives
+        sample current {};
+        std::atomic<bool> read_queued { false };
+    };
+
+    static constexpr size_t MAX_PENDING = 256;
+
+    lv_display_t* display;
+    // read once on the LVGL thread; the input thread must not call into lvgl
+    int32_t display_width;
+    int32_t display_height;
+    std::vector<std::unique_ptr<device>> devices;
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    std::thread thread;
+    std::atomic<bool> running { false };
+
+    void run();
+    void read_events(device& d);
+    void queue_sample(device& d, std::chrono::steady_clock::time_point time);
+    static void read_cb(lv_indev_t* indev, lv_indev_data_t* data);
+};
+
+#endif // EVDEV_INPUT_H
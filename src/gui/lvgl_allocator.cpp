@@ -0,0 +1,342 @@
+// LV_STDLIB_CUSTOM backend for lv_malloc()/lv_free(). Small blocks come from
+// per-size-class slabs that are allocated on demand and returned to the system
+// as soon as they are empty; everything else goes straight to malloc. Usage is
+// published through the bifrost stats surface.
+
+#include "lv_conf.h"
+#include <lvgl.h>
+
+#include "../utils/stats.h"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+namespace {
+
+constexpr size_t SLAB_SIZE = 64 * 1024;
+constexpr std::array<uint32_t, 16> CLASS_SIZES = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048,
+    3072, 4096 };
+constexpr uint32_t LARGE = UINT32_MAX;
+
+struct slab;
+
+// in front of every block; 16 bytes keeps the payload 16-byte aligned
+struct block_header {
+    slab* owner; // nullptr for large blocks
+    uint32_t size; // requested size
+    uint32_t size_class;
+};
+static_assert(sizeof(block_header) == 16);
+
+struct free_block {
+    free_block* next;
+};
+
+struct slab {
+    slab* prev;
+    slab* next;
+    free_block* free_list;
+    uint32_t used;
+    uint32_t capacity;
+    uint32_t size_class;
+};
+
+struct size_class {
+    // slabs with at least one free block
+    slab* partial = nullptr;
+    uint32_t slabs = 0;
+    uint32_t blocks = 0;
+    stats::counter* blocks_stat = nullptr;
+};
+
+struct allocator {
+    std::mutex mutex;
+    std::array<size_class, CLASS_SIZES.size()> classes;
+
+    size_t slab_bytes = 0;
+    size_t small_bytes = 0; // payload capacity of the small blocks in use
+    size_t large_bytes = 0;
+    size_t large_blocks = 0;
+    size_t requested_bytes = 0;
+    size_t peak_bytes = 0;
+
+    stats::counter& requested_stat = stats::get("lvgl_mem.bytes_in_use");
+    stats::counter& peak_stat = stats::get("lvgl_mem.peak_bytes");
+    stats::counter& slab_stat = stats::get("lvgl_mem.slab_bytes");
+    stats::counter& large_stat = stats::get("lvgl_mem.large_bytes");
+    stats::counter& fragmentation_stat = stats::get("lvgl_mem.slab_frag_pct");
+
+    allocator()
+    {
+        for (size_t i = 0; i < CLASS_SIZES.size(); i++) {
+            classes[i].blocks_stat = &stats::get("lvgl_mem.class_" + std::to_string(CLASS_SIZES[i]) + ".blocks");
+        }
+    }
+
+    // share of the slab memory that is not handed out
+    uint32_t fragmentation_pct() const
+    {
+        return slab_bytes ? static_cast<uint32_t>(100 - small_bytes * 100 / slab_bytes) : 0;
+    }
+
+    void publish()
+    {
+        peak_bytes = std::max(peak_bytes, requested_bytes);
+        requested_stat.set(requested_bytes);
+        peak_stat.set(peak_bytes);
+        slab_stat.set(slab_bytes);
+        large_stat.set(large_bytes);
+        fragmentation_stat.set(fragmentation_pct());
+    }
+};
+
+allocator& instance()
+{
+    // never destroyed: lvgl may still free memory during static destruction
+    static auto* a = new allocator();
+    return *a;
+}
+
+uint32_t class_for(size_t size)
+{
+    for (uint32_t i = 0; i < CLASS_SIZES.size(); i++) {
+        if (size <= CLASS_SIZES[i]) {
+            return i;
+        }
+    }
+    return LARGE;
+}
+
+void unlink(size_class& c, slab* s)
+{
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        c.partial = s->next;
+    }
+    if (s->next) {
+        s->next->prev = s->prev;
+    }
+    s->prev = s->next = nullptr;
+}
+
+void push_front(size_class& c, slab* s)
+{
+    s->prev = nullptr;
+    s->next = c.partial;
+    if (c.partial) {
+        c.partial->prev = s;
+    }
+    c.partial = s;
+}
+
+slab* create_slab(allocator& a, uint32_t class_index)
+{
+    auto s = static_cast<slab*>(std::aligned_alloc(16, SLAB_SIZE));
+    if (!s) {
+        return nullptr;
+    }
+
+    uint32_t stride = sizeof(block_header) + CLASS_SIZES[class_index];
+    // the slab header is padded to 16 bytes so that every block stays aligned
+    size_t first = (sizeof(slab) + 15) & ~size_t(15);
+    *s = { nullptr, nullptr, nullptr, 0, static_cast<uint32_t>((SLAB_SIZE - first) / stride), class_index };
+
+    auto base = reinterpret_cast<uint8_t*>(s) + first;
+    for (uint32_t i = s->capacity; i-- > 0;) {
+        auto block = reinterpret_cast<free_block*>(base + i * stride);
+        block->next = s->free_list;
+        s->free_list = block;
+    }
+
+    a.classes[class_index].slabs++;
+    a.slab_bytes += SLAB_SIZE;
+    return s;
+}
+
+void* allocate(allocator& a, size_t size)
+{
+    auto class_index = class_for(size);
+    block_header* header;
+    if (class_index == LARGE) {
+        header = static_cast<block_header*>(std::malloc(sizeof(block_header) + size));
+        if (!header) {
+            return nullptr;
+        }
+        *header = { nullptr, static_cast<uint32_t>(size), LARGE };
+        a.large_bytes += size;
+        a.large_blocks++;
+    } else {
+        auto& c = a.classes[class_index];
+        if (!c.partial) {
+            auto s = create_slab(a, class_index);
+            if (!s) {
+                return nullptr;
+            }
+            push_front(c, s);
+        }
+
+        auto s = c.partial;
+        auto block = s->free_list;
+        s->free_list = block->next;
+        if (++s->used == s->capacity) {
+            unlink(c, s);
+        }
+
+        header = reinterpret_cast<block_header*>(block);
+        *header = { s, static_cast<uint32_t>(size), class_index };
+        c.blocks_stat->set(++c.blocks);
+        a.small_bytes += sizeof(block_header) + CLASS_SIZES[class_index];
+    }
+
+    a.requested_bytes += size;
+    a.publish();
+    return header + 1;
+}
+
+void release(allocator& a, void* p)
+{
+    auto header = static_cast<block_header*>(p) - 1;
+    a.requested_bytes -= header->size;
+
+    if (header->size_class == LARGE) {
+        a.large_bytes -= header->size;
+        a.large_blocks--;
+        std::free(header);
+        a.publish();
+        return;
+    }
+
+    auto s = header->owner;
+    auto class_index = header->size_class;
+    auto& c = a.classes[class_index];
+    bool was_full = s->used == s->capacity;
+    auto block = reinterpret_cast<free_block*>(header);
+    block->next = s->free_list;
+    s->free_list = block;
+    s->used--;
+    c.blocks_stat->set(--c.blocks);
+    a.small_bytes -= sizeof(block_header) + CLASS_SIZES[class_index];
+
+    if (was_full) {
+        push_front(c, s);
+    }
+
+    // give empty slabs back, except when it is the class's only slab with room, to avoid churn
+    if (s->used == 0 && (s->prev || s->next)) {
+        unlink(c, s);
+        c.slabs--;
+        a.slab_bytes -= SLAB_SIZE;
+        std::free(s);
+    }
+    a.publish();
+}
+
+}
+
+void lv_mem_init(void)
+{
+    instance();
+}
+
+void lv_mem_deinit(void)
+{
+}
+
+lv_mem_pool_t lv_mem_add_pool(void*, size_t)
+{
+    // memory grows and shrinks on demand; fixed pools are not used
+    return nullptr;
+}
+
+void lv_mem_remove_pool(lv_mem_pool_t)
+{
+}
+
+void* lv_malloc_core(size_t size)
+{
+    auto& a = instance();
+    std::lock_guard lock(a.mutex);
+    return allocate(a, size);
+}
+
+void* lv_realloc_core(void* p, size_t new_size)
+{
+    if (!p) {
+        return lv_malloc_core(new_size);
+    }
+
+    auto& a = instance();
+    std::lock_guard lock(a.mutex);
+    auto header = static_cast<block_header*>(p) - 1;
+    uint32_t class_index = header->size_class;
+    if (class_index != LARGE && new_size <= CLASS_SIZES[class_index] && class_for(new_size) == class_index) {
+        a.requested_bytes = a.requested_bytes - header->size + new_size;
+        header->size = static_cast<uint32_t>(new_size);
+        a.publish();
+        return p;
+    }
+
+    auto result = allocate(a, new_size);
+    if (result) {
+        std::memcpy(result, p, std::min<size_t>(header->size, new_size));
+        release(a, p);
+    }
+    return result;
+}
+
+void lv_free_core(void* p)
+{
+    if (!p) {
+        return;
+    }
+
+    auto& a = instance();
+    std::lock_guard lock(a.mutex);
+    release(a, p);
+}
+
+void lv_mem_monitor_core(lv_mem_monitor_t* mon_p)
+{
+    auto& a = instance();
+    std::lock_guard lock(a.mutex);
+
+    uint32_t used_blocks = a.large_blocks;
+    uint32_t free_blocks = 0;
+    uint32_t biggest_free = 0;
+    for (size_t i = 0; i < a.classes.size(); i++) {
+        used_blocks += a.classes[i].blocks;
+        for (auto s = a.classes[i].partial; s; s = s->next) {
+            free_blocks += s->capacity - s->used;
+            biggest_free = CLASS_SIZES[i];
+        }
+    }
+
+    mon_p->total_size = a.slab_bytes + a.large_bytes;
+    mon_p->free_cnt = free_blocks;
+    mon_p->free_size = a.slab_bytes - a.small_bytes;
+    mon_p->free_biggest_size = biggest_free;
+    mon_p->used_cnt = used_blocks;
+    mon_p->max_used = a.peak_bytes;
+    mon_p->used_pct = mon_p->total_size ? 100 - mon_p->free_size * 100 / mon_p->total_size : 0;
+    mon_p->frag_pct = a.fragmentation_pct();
+}
+
+lv_result_t lv_mem_test_core(void)
+{
+    auto& a = instance();
+    std::lock_guard lock(a.mutex);
+
+    // every slab on a partial list must have room and belong to its class
+    for (uint32_t i = 0; i < a.classes.size(); i++) {
+        for (auto s = a.classes[i].partial; s; s = s->next) {
+            if (s->size_class != i || s->used >= s->capacity || !s->free_list) {
+                return LV_RESULT_INVALID;
+            }
+        }
+    }
+    return LV_RESULT_OK;
+}
@@ -1,4 +1,7 @@
 #include "lvgl_renderer.h"
+#include "../utils/pixel_convert.h"
+#include "../utils/stats.h"
+#include "../utils/trace.h"
 
 #include <spdlog/spdlog.h>
 
@@ -9,51 +12,191 @@ uint32_t lv_tick_cb()
     return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
-void lvgl_renderer::lv_display_flush(lv_display_t* disp, const lv_area_t* area, uint8_t* color_p)
+// copy one row segment from the lvgl buffer to the QImage buffer and record the changed pixels
+void lvgl_renderer::copy_span(const QRgb* src, QRgb* dst, uint32_t y, uint32_t x1, uint32_t x2)
 {
-    int fb_width = fb->width();
-    int fb_height = fb->height();
-    int fb_depth = fb->depth() / 8;
-    assert(fb_depth == 4);
-
-    point p1 = { area->x2, area->y2 };
-    point p2 = { area->x1, area->y1 };
-    bool pixel_changed = false;
-    bool color_refresh = false;
-    // copy the area from the lvgl buffer to the QImage buffer
-    for (uint32_t y = area->y1; y <= area->y2; y++) {
-        QRgb* line = reinterpret_cast<QRgb*>(fb->scanLine(y));
-        int lvgl_idx = (y * fb_width + area->x1) * fb_depth;
-        for (uint32_t x = area->x1; x <= area->x2; x++) {
-            // find the smallest rectangle that contains pixel difference
-            QRgb color = *reinterpret_cast<uint32_t*>(&color_p[lvgl_idx]);
+    uint32_t changed_x1 = x2 + 1;
+    uint32_t changed_x2 = 0;
+    auto content = pixel_content::NONE;
 
-            if (line[x] != color) {
-                pixel_changed = true;
+    for (uint32_t x = x1; x <= x2; x++) {
+        QRgb color = src[x];
+        if (dst[x] != color) {
+            content = std::max(content, classify_pixel(color));
+            changed_x1 = std::min(changed_x1, x);
+            changed_x2 = x;
+            dst[x] = color;
+        }
+    }
 
-                // check if the color is monochrome or grayscale
-                if (color != qRgba(255, 255, 255, 255) && color != qRgba(0, 0, 0, 255) && (qRed(color) != qGreen(color) || qGreen(color) != qBlue(color))) {
-                    color_refresh = true;
-                }
+    if (changed_x1 <= changed_x2) {
+        damage.mark_span(y, changed_x1, changed_x2, content);
+    }
+}
+
+// turn the accumulated damage into one refresh request per merged region
+void lvgl_renderer::submit_damage()
+{
+    auto regions = damage.collect();
+    if (regions.empty()) {
+        return;
+    }
+
+    // the hints are set from the lvgl thread while this may run on the flush thread
+    refresh_type hint = global_refresh_hint;
+    bool full_refresh = full_refresh_requested.exchange(false);
+    for (const auto& region : regions) {
+        spdlog::debug("damaged region: {}x{}-{}x{} (content {})", region.area.p1.x, region.area.p1.y,
+                      region.area.p2.x, region.area.p2.y, static_cast<int>(region.type));
+
+        refresh_type type = hint;
+        if (full_refresh) {
+            type = FULL;
+        } else if (hint == AUTO) {
+            type = fastest_refresh_type(region.type);
+        } else if (region.type >= pixel_content::PALETTE) {
+            type = std::max(hint, COLOR_ANIMATION);
+        }
+        refresh_func(region.area, type);
+    }
+}
+
+uint64_t lvgl_renderer::checksum_tile(uint32_t column, uint32_t row) const
+{
+    // FNV-1a over whole pixels; good enough to tell a redrawn tile from an untouched one
+    auto bounds = damage.tile_bounds(column, row);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t y = bounds.p1.y; y <= bounds.p2.y; y++) {
+        auto line = reinterpret_cast<const QRgb*>(fb->constScanLine(y));
+        for (uint32_t x = bounds.p1.x; x <= bounds.p2.x; x++) {
+            hash = (hash ^ line[x]) * 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+// lvgl has already drawn into the framebuffer; compare the touched tiles against the checksum shadow
+void lvgl_renderer::diff_in_place(const lv_area_t* area)
+{
+    for (uint32_t row = area->y1 / damage_grid::TILE_SIZE; row <= area->y2 / damage_grid::TILE_SIZE; row++) {
+        for (uint32_t column = area->x1 / damage_grid::TILE_SIZE; column <= area->x2 / damage_grid::TILE_SIZE; column++) {
+            auto& shadow = tile_checksums[row * damage.columns() + column];
+            auto checksum = checksum_tile(column, row);
+            if (checksum == shadow) {
+                continue;
+            }
+            shadow = checksum;
 
-                p1.x = std::min(p1.x, x);
-                p1.y = std::min(p1.y, y);
-                p2.x = std::max(p2.x, x);
-                p2.y = std::max(p2.y, y);
+            auto bounds = damage.tile_bounds(column, row);
+            auto content = pixel_content::NONE;
+            for (uint32_t y = bounds.p1.y; y <= bounds.p2.y && content != pixel_content::COLOR; y++) {
+                auto line = reinterpret_cast<const QRgb*>(fb->constScanLine(y));
+                for (uint32_t x = bounds.p1.x; x <= bounds.p2.x; x++) {
+                    content = std::max(content, classify_pixel(line[x]));
+                }
             }
-            line[x] = color;
-            lvgl_idx += 4;
+            damage.mark_tile(column, row, content);
+        }
+    }
+}
+
+// flush thread: copy one area of the buffer lvgl just finished into the framebuffer
+void lvgl_renderer::copy_area(const flush_job& job)
+{
+    TRACE_SCOPE("copy_area");
+    const lv_area_t* area = &job.area;
+    uint32_t src_stride = fb->width() * (job.l8 ? 1 : 4);
+    uint32_t area_width = area->x2 - area->x1 + 1;
+    if (dither_enabled) {
+        dither.set_mode(dither_mode_for(global_refresh_hint));
+    }
+
+    // copy the area tile column by tile column so that every changed pixel lands in its tile
+    for (uint32_t y = area->y1; y <= area->y2; y++) {
+        QRgb* line = reinterpret_cast<QRgb*>(fb->scanLine(y));
+        const QRgb* src = reinterpret_cast<const QRgb*>(&job.pixels[y * src_stride]);
+        // the other buffer is synced from this one in DIRECT mode, so convert a copy of the row
+        if (job.l8) {
+            expand_l8_to_argb8888(&job.pixels[y * src_stride + area->x1], &line_buffer[area->x1], area_width);
+            src = line_buffer.data();
+        } else if (dither_enabled) {
+            std::copy_n(&src[area->x1], area_width, &line_buffer[area->x1]);
+            src = line_buffer.data();
+        }
+        if (dither_enabled) {
+            dither.dither_row(line_buffer.data(), y, area->x1, area->x2);
+        }
+        for (uint32_t x1 = area->x1; x1 <= static_cast<uint32_t>(area->x2);) {
+            uint32_t x2 = std::min<uint32_t>(area->x2, (x1 / damage_grid::TILE_SIZE + 1) * damage_grid::TILE_SIZE - 1);
+            copy_span(src, line, y, x1, x2);
+            x1 = x2 + 1;
+        }
+    }
+
+    // lvgl flushes every invalidated area separately; merge them once the frame is complete
+    if (job.last) {
+        submit_damage();
+    }
+}
+
+void lvgl_renderer::flush_worker()
+{
+    std::unique_lock lock(flush_mutex);
+    while (true) {
+        flush_cv.wait(lock, [this] { return pending_flush || flush_stopping; });
+        if (!pending_flush) {
+            return;
         }
+
+        auto job = *pending_flush;
+        pending_flush.reset();
+        flush_busy = true;
+        lock.unlock();
+
+        copy_area(job);
+
+        lock.lock();
+        flush_busy = false;
+        // like a DMA completion: lvgl may reuse the buffer from here on
+        lv_display_flush_ready(display);
+        flush_cv.notify_all();
     }
+}
 
-    spdlog::debug("requested flushing area: {}x{}-{}x{}; actual flushing area: {}x{}-{}x{}",
-                  area->x1, area->y1, area->x2, area->y2, p1.x, p1.y, p2.x, p2.y);
+// lvgl thread: block until the flush thread has released the buffer
+void lvgl_renderer::wait_for_flush()
+{
+    static auto& wait_max = stats::get("lvgl.flush_wait_us_max");
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock lock(flush_mutex);
+    flush_cv.wait(lock, [this] { return !pending_flush && !flush_busy; });
+    wait_max.update_max(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
 
-    if (pixel_changed) {
-        refresh_func(rect{ .p1 = p1, .p2 = p2 }, full_refresh_requested ? FULL : (color_refresh ? std::max(global_refresh_hint, COLOR_ANIMATION) : global_refresh_hint));
-        full_refresh_requested = false;
+void lvgl_renderer::lv_display_flush(lv_display_t* disp, const lv_area_t* area, uint8_t* color_p)
+{
+    TRACE_SCOPE("lv_display_flush");
+    assert(fb->depth() == 32);
+
+    spdlog::debug("requested flushing area: {}x{}-{}x{}", area->x1, area->y1, area->x2, area->y2);
+
+    if (render_in_place) {
+        diff_in_place(area);
+        if (lv_display_flush_is_last(disp)) {
+            submit_damage();
+        }
+        lv_display_flush_ready(disp);
+        return;
+    }
+
+    // hand the area to the flush thread and let lvgl go on rasterizing
+    {
+        std::lock_guard lock(flush_mutex);
+        pending_flush = flush_job { *area, color_p, lv_display_get_color_format(disp) == LV_COLOR_FORMAT_L8,
+                                    lv_display_flush_is_last(disp) };
     }
-    lv_display_flush_ready(disp);
+    flush_cv.notify_all();
 }
 
 void lvgl_renderer::lv_display_flush_cb(lv_display_t* disp, const lv_area_t* area, uint8_t* color_p)
@@ -65,27 +208,59 @@ void lvgl_renderer::lv_display_flush_cb(lv_display_t* disp, const lv_area_t* are
     instance->lv_display_flush(disp, area, color_p);
 }
 
+void lvgl_renderer::lv_display_flush_wait_cb(lv_display_t* disp)
+{
+    auto instance = lvgl_renderer::instance.lock();
+    if (!instance)
+        return;
+
+    instance->wait_for_flush();
+}
+
 void lvgl_renderer::initialize()
 {
+    // runs before the render thread takes ownership of lvgl, so no other thread can touch it yet
     instance = shared_from_this();
-    std::lock_guard<std::mutex> lock(g_lvgl_mutex);
 
     lv_init();
     lv_tick_set_cb(lv_tick_cb);
     display = lv_display_create(fb->width(), fb->height());
     lv_display_set_color_format(display, LV_COLOR_FORMAT_ARGB8888);
 
-    lv_indev_t* touch = lv_evdev_create(LV_INDEV_TYPE_POINTER, "/dev/input/event3");
-    lv_evdev_set_calibration(touch, 0, 0, 2058, 2826);
-    lv_indev_set_display(touch, display);
-
-    lv_indev_t* pen = lv_evdev_create(LV_INDEV_TYPE_POINTER, "/dev/input/event2");
-    lv_evdev_set_calibration(pen, 0, 0, 11172, 15328);
-    lv_indev_set_display(pen, display);
+    input = std::make_unique<evdev_input>(display);
+    input->add_pointer("/dev/input/event3", 2058, 2826); // touch
+    input->add_pointer("/dev/input/event2", 11172, 15328); // pen
+    input->start();
 
     auto buf_size = fb->width() * fb->height() * fb->depth() / 8;
-    composite_buffer = new uint8_t[buf_size];
-    lv_display_set_buffers(display, composite_buffer, nullptr, buf_size, LV_DISPLAY_RENDER_MODE_DIRECT);
+    line_buffer.resize(fb->width());
+    render_in_place = std::getenv(ENV_RENDER_IN_PLACE) != nullptr;
+    dither_enabled = std::getenv(ENV_DITHER) != nullptr;
+    if (render_in_place && fb->bytesPerLine() != fb->width() * 4) {
+        spdlog::warn("framebuffer stride {} is not packed; rendering through a copy", fb->bytesPerLine());
+        render_in_place = false;
+    }
+    if (render_in_place && dither_enabled) {
+        spdlog::warn("dithering needs a copy of the lvgl output; not dithering while rendering in place");
+        dither_enabled = false;
+    }
+
+    if (render_in_place) {
+        tile_checksums.resize(damage.columns() * damage.rows());
+        for (uint32_t row = 0; row < damage.rows(); row++) {
+            for (uint32_t column = 0; column < damage.columns(); column++) {
+                tile_checksums[row * damage.columns() + column] = checksum_tile(column, row);
+            }
+        }
+        lv_display_set_buffers(display, fb->bits(), nullptr, buf_size, LV_DISPLAY_RENDER_MODE_DIRECT);
+        spdlog::info("lvgl renders directly into the framebuffer");
+    } else {
+        composite_buffers[0] = new uint8_t[buf_size];
+        composite_buffers[1] = new uint8_t[buf_size];
+        lv_display_set_buffers(display, composite_buffers[0], composite_buffers[1], buf_size, LV_DISPLAY_RENDER_MODE_DIRECT);
+        flush_thread = std::thread(&lvgl_renderer::flush_worker, this);
+        lv_display_set_flush_wait_cb(display, lv_display_flush_wait_cb);
+    }
     lv_display_set_flush_cb(display, lv_display_flush_cb);
 
     lv_obj_set_style_bg_color(lv_screen_active(), LV_COLOR_MAKE(255, 255, 255), LV_STATE_DEFAULT);
@@ -97,12 +272,45 @@ void lvgl_renderer::initialize()
 }
 
 lvgl_renderer::~lvgl_renderer() {
-    // TODO: free resources
+    // TODO: free lvgl resources
+    if (input) {
+        input->stop();
+    }
+    if (flush_thread.joinable()) {
+        {
+            std::lock_guard lock(flush_mutex);
+            flush_stopping = true;
+        }
+        flush_cv.notify_all();
+        flush_thread.join();
+    }
+    delete[] composite_buffers[0];
+    delete[] composite_buffers[1];
+}
+
+void lvgl_renderer::set_color_format(lv_color_format_t format)
+{
+    if (format == lv_display_get_color_format(display)) {
+        return;
+    }
+    if (render_in_place && format != LV_COLOR_FORMAT_ARGB8888) {
+        spdlog::warn("rendering in place needs the framebuffer format; staying on ARGB8888");
+        return;
+    }
+
+    // the buffers are sized for ARGB8888, so they also hold L8; setting them again recomputes the stride
+    wait_for_flush();
+    lv_display_set_color_format(display, format);
+    lv_display_set_buffers(display, composite_buffers[0], composite_buffers[1], fb->width() * fb->height() * fb->depth() / 8,
+                           LV_DISPLAY_RENDER_MODE_DIRECT);
+    // DIRECT mode only redraws invalidated areas and the old pixels are in the old format
+    lv_obj_invalidate(lv_screen_active());
+    spdlog::debug("lvgl color format set to {}", static_cast<int>(format));
 }
 
 void lvgl_renderer::tick()
 {
-    std::lock_guard lock(g_lvgl_mutex);
+    g_ui_tasks.drain();
     lv_timer_handler();
 }
 
@@ -4,22 +4,33 @@
 
 #include "../constants.h"
 #include "../hook_typedefs.h"
+#include "../utils/damage_grid.h"
+#include "../utils/dither.h"
+#include "../utils/ui_task_queue.h"
+#include "evdev_input.h"
 #include "lv_conf.h"
 
 #include <QImage>
+#include <atomic>
 #include <condition_variable>
 #include <lvgl.h>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 
 class lvgl_renderer : public std::enable_shared_from_this<lvgl_renderer> {
 public:
     explicit lvgl_renderer(QImage* fb, std::function<void(rect, refresh_type)> refresh_func)
-        : fb(fb),refresh_func(refresh_func)
+        : fb(fb),refresh_func(refresh_func), damage(fb->width(), fb->height()), dither(fb->width())
     {
     }
     void initialize();
     void request_full_refresh();
     void set_global_refresh_hint(refresh_type hint) { global_refresh_hint = hint; }
+    // LV_COLOR_FORMAT_L8 draws 1 byte per pixel for screens without color content. LVGL thread only.
+    void set_color_format(lv_color_format_t format);
     void tick();
     ~lvgl_renderer();
 private:
@@ -27,14 +38,47 @@ private:
     QImage* fb;
     std::function<void(rect, refresh_type)> refresh_func;
     lv_display_t* display;
-    uint8_t* composite_buffer;
+    std::unique_ptr<evdev_input> input;
+    // lvgl draws into one buffer while the flush thread copies the other to the framebuffer
+    uint8_t* composite_buffers[2] = {};
+    // render straight into the framebuffer and detect changes with per-tile checksums
+    bool render_in_place = false;
+    std::vector<uint64_t> tile_checksums;
+    // one framebuffer row, staged for L8 expansion or dithering
+    std::vector<QRgb> line_buffer;
     long last_full_refresh_time = 0;
-    bool full_refresh_requested = false;
+    std::atomic<bool> full_refresh_requested = false;
+    damage_grid damage;
+    // quantize lvgl output to what the fast waveforms can show (BIFROST_DITHER)
+    bool dither_enabled = false;
+    ditherer dither;
 
-    refresh_type global_refresh_hint = MONOCHROME;
+    std::atomic<refresh_type> global_refresh_hint = MONOCHROME;
 
+    struct flush_job {
+        lv_area_t area;
+        const uint8_t* pixels;
+        bool l8;
+        bool last;
+    };
+    std::thread flush_thread;
+    std::mutex flush_mutex;
+    std::condition_variable flush_cv;
+    // lvgl waits for each flush before it hands over the next one, so one slot is enough
+    std::optional<flush_job> pending_flush;
+    bool flush_busy = false;
+    bool flush_stopping = false;
+
+    void copy_span(const QRgb* src, QRgb* dst, uint32_t y, uint32_t x1, uint32_t x2);
+    void submit_damage();
+    uint64_t checksum_tile(uint32_t column, uint32_t row) const;
+    void diff_in_place(const lv_area_t* area);
+    void copy_area(const flush_job& job);
+    void flush_worker();
+    void wait_for_flush();
     void lv_display_flush(lv_display_t* disp, const lv_area_t* area, uint8_t* color_p);
     static void lv_display_flush_cb(lv_display_t* disp, const lv_area_t* area, uint8_t* color_p);
+    static void lv_display_flush_wait_cb(lv_display_t* disp);
 };
 
 #endif // LVGL_APP_H
@@ -19,9 +19,11 @@ static void pressing_cb(lv_event_t * e)
 void system_ui::initialize()
 {
     instance = shared_from_this();
+    g_ui_tasks.run([this] { create_navbar(); });
+}
 
-    std::lock_guard<std::mutex> lock(g_lvgl_mutex);
-
+void system_ui::create_navbar()
+{
     navbar = lv_obj_create(lv_layer_top());
     lv_obj_set_size(navbar, LV_PCT(100), title_bar_height);
     lv_obj_set_style_border_side(navbar, LV_BORDER_SIDE_BOTTOM, 0);
@@ -83,15 +85,22 @@ void system_ui::initialize()
 
 system_ui::~system_ui()
 {
-    while (!deletion_queue.empty()) {
-        lv_obj_del(deletion_queue.top());
-        deletion_queue.pop();
-    }
+    g_ui_tasks.run([this] {
+        while (!deletion_queue.empty()) {
+            lv_obj_del(deletion_queue.top());
+            deletion_queue.pop();
+        }
+    });
 }
 
 void system_ui::set_content(content_info info)
 {
-    std::lock_guard<std::mutex> lock(g_lvgl_mutex);
+    // called with the compositor's client lock held, so never wait for the render thread here
+    g_ui_tasks.dispatch([this, info] { apply_content(info); });
+}
+
+void system_ui::apply_content(const content_info& info)
+{
     if (info.type == content_type::BIFROST) {
         lv_label_set_text(title_label, info.title.c_str());
         lv_obj_add_flag(left_action, LV_OBJ_FLAG_HIDDEN);
@@ -40,6 +40,9 @@ private:
     bool application_exit_requested = false;
 
 
+    void create_navbar();
+    void apply_content(const content_info& info);
+
     static void gesture_cb(lv_event_t * e);
     static void left_action_cb(lv_event_t * e);
     static void right_action_cb(lv_event_t * e);
@@ -0,0 +1,123 @@
+#include "damage_grid.h"
+
+damage_grid::damage_grid(uint32_t width, uint32_t height)
+    : width(width)
+    , height(height)
+    , grid_columns((width + TILE_SIZE - 1) / TILE_SIZE)
+    , grid_rows((height + TILE_SIZE - 1) / TILE_SIZE)
+    , tiles(grid_columns * grid_rows, tile { 0, 0, 0, 0, content::NONE })
+{
+}
+
+void damage_grid::mark_span(uint32_t y, uint32_t x1, uint32_t x2, content type)
+{
+    if (y >= height || x1 > x2 || x1 >= width) {
+        return;
+    }
+    x2 = std::min(x2, width - 1);
+
+    auto row = y / TILE_SIZE;
+    for (auto column = x1 / TILE_SIZE; column <= x2 / TILE_SIZE; column++) {
+        auto& t = tiles[row * grid_columns + column];
+        uint16_t span_x1 = std::max(x1, column * TILE_SIZE);
+        uint16_t span_x2 = std::min(x2, (column + 1) * TILE_SIZE - 1);
+
+        if (t.type == content::NONE) {
+            t = { span_x1, static_cast<uint16_t>(y), span_x2, static_cast<uint16_t>(y), type };
+            dirty_tiles++;
+            continue;
+        }
+
+        t.x1 = std::min(t.x1, span_x1);
+        t.x2 = std::max(t.x2, span_x2);
+        t.y1 = std::min(t.y1, static_cast<uint16_t>(y));
+        t.y2 = std::max(t.y2, static_cast<uint16_t>(y));
+        t.type = std::max(t.type, type);
+    }
+}
+
+void damage_grid::mark_tile(uint32_t column, uint32_t row, content type)
+{
+    if (column >= grid_columns || row >= grid_rows) {
+        return;
+    }
+
+    auto bounds = tile_bounds(column, row);
+    auto& t = tiles[row * grid_columns + column];
+    if (t.type == content::NONE) {
+        dirty_tiles++;
+    }
+    t = { static_cast<uint16_t>(bounds.p1.x), static_cast<uint16_t>(bounds.p1.y),
+          static_cast<uint16_t>(bounds.p2.x), static_cast<uint16_t>(bounds.p2.y), std::max(t.type, type) };
+}
+
+rect damage_grid::tile_bounds(uint32_t column, uint32_t row) const
+{
+    return { { column * TILE_SIZE, row * TILE_SIZE },
+             { std::min((column + 1) * TILE_SIZE, width) - 1, std::min((row + 1) * TILE_SIZE, height) - 1 } };
+}
+
+std::vector<damage_grid::region> damage_grid::collect()
+{
+    struct run {
+        uint32_t column1;
+        uint32_t column2;
+        region reg;
+    };
+
+    std::vector<region> regions;
+    if (dirty_tiles == 0) {
+        return regions;
+    }
+
+    // runs that can still grow downwards; a run stays open as long as the
+    // next tile row has a run with exactly the same columns and content
+    std::vector<run> open_runs;
+
+    for (uint32_t row = 0; row < grid_rows; row++) {
+        std::vector<run> row_runs;
+        for (uint32_t column = 0; column < grid_columns; column++) {
+            auto& t = tiles[row * grid_columns + column];
+            if (t.type == content::NONE) {
+                continue;
+            }
+
+            rect area { { t.x1, t.y1 }, { t.x2, t.y2 } };
+            if (!row_runs.empty()) {
+                auto& prev = row_runs.back();
+                if (prev.column2 + 1 == column && prev.reg.type == t.type) {
+                    prev.column2 = column;
+                    prev.reg.area = prev.reg.area.union_(area);
+                    continue;
+                }
+            }
+            row_runs.push_back({ column, column, { area, t.type } });
+        }
+
+        std::vector<run> next_open;
+        for (auto& current : row_runs) {
+            auto it = std::find_if(open_runs.begin(), open_runs.end(), [&](const run& r) {
+                return r.column1 == current.column1 && r.column2 == current.column2 && r.reg.type == current.reg.type;
+            });
+            if (it != open_runs.end()) {
+                current.reg.area = current.reg.area.union_(it->reg.area);
+                open_runs.erase(it);
+            }
+            next_open.push_back(current);
+        }
+
+        // whatever did not continue into this row is final
+        for (auto& r : open_runs) {
+            regions.push_back(r.reg);
+        }
+        open_runs = std::move(next_open);
+    }
+
+    for (auto& r : open_runs) {
+        regions.push_back(r.reg);
+    }
+
+    std::fill(tiles.begin(), tiles.end(), tile { 0, 0, 0, 0, content::NONE });
+    dirty_tiles = 0;
+    return regions;
+}
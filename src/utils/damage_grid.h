@@ -0,0 +1,59 @@
+#ifndef DAMAGE_GRID_H
+#define DAMAGE_GRID_H
+
+#include "data_structs.h"
+#include "waveform_classifier.h"
+
+#include <cstdint>
+#include <vector>
+
+// Tracks changed pixels on a grid of fixed-size tiles and merges the dirty
+// tiles into a small set of rectangles, each with its own content class.
+class damage_grid {
+public:
+    static constexpr uint32_t TILE_SIZE = 64;
+
+    using content = pixel_content;
+
+    struct region {
+        rect area;
+        content type;
+    };
+
+    damage_grid(uint32_t width, uint32_t height);
+
+    // Mark pixels x1..x2 (inclusive) of row y as changed.
+    void mark_span(uint32_t y, uint32_t x1, uint32_t x2, content type);
+
+    // Mark a whole tile as changed.
+    void mark_tile(uint32_t column, uint32_t row, content type);
+
+    // Pixel bounds (inclusive) of a tile, clipped to the grid size.
+    rect tile_bounds(uint32_t column, uint32_t row) const;
+
+    // Merge dirty tiles into regions and reset the grid.
+    std::vector<region> collect();
+
+    bool empty() const { return dirty_tiles == 0; }
+    uint32_t columns() const { return grid_columns; }
+    uint32_t rows() const { return grid_rows; }
+
+private:
+    struct tile {
+        // tight bounds of the changed pixels inside the tile
+        uint16_t x1;
+        uint16_t y1;
+        uint16_t x2;
+        uint16_t y2;
+        content type;
+    };
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t grid_columns;
+    uint32_t grid_rows;
+    uint32_t dirty_tiles = 0;
+    std::vector<tile> tiles;
+};
+
+#endif // DAMAGE_GRID_H
@@ -0,0 +1,214 @@
+#include "dither.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr uint8_t BAYER_8X8[8][8] = {
+    { 0, 32, 8, 40, 2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44, 4, 36, 14, 46, 6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    { 3, 35, 11, 43, 1, 33, 9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47, 7, 39, 13, 45, 5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+// per row, the 8 thresholds twice so that 4 consecutive ones can be loaded from any x & 7.
+// A channel is set when it is at least threshold + 1, which keeps 0 and 255 unchanged.
+struct threshold_table {
+    uint32_t luma[8][16];
+    uint32_t channels[8][16]; // threshold + 1 in each of the B, G and R bytes
+
+    threshold_table()
+    {
+        for (int y = 0; y < 8; y++) {
+            for (int x = 0; x < 16; x++) {
+                uint32_t threshold = BAYER_8X8[y][x & 7] * 4 + 2;
+                luma[y][x] = threshold;
+                channels[y][x] = (threshold + 1) * 0x010101u;
+            }
+        }
+    }
+};
+
+const threshold_table thresholds;
+
+inline uint32_t luma(uint32_t argb)
+{
+    return (((argb >> 16) & 0xff) * 77 + ((argb >> 8) & 0xff) * 150 + (argb & 0xff) * 29) >> 8;
+}
+
+inline uint32_t ordered_pixel(uint32_t argb, uint32_t x, uint32_t y, dither_palette palette)
+{
+    uint32_t threshold = thresholds.luma[y & 7][x & 7];
+    if (palette == dither_palette::BLACK_WHITE) {
+        return luma(argb) > threshold ? 0xffffffffu : 0xff000000u;
+    }
+
+    uint32_t result = 0xff000000u;
+    for (int shift = 0; shift < 24; shift += 8) {
+        if (((argb >> shift) & 0xff) > threshold) {
+            result |= 0xffu << shift;
+        }
+    }
+    return result;
+}
+
+// four pixels starting at x; thresholds repeat every 8 pixels so x & 7 <= 7 stays within the table row
+void ordered_row(uint32_t* line, uint32_t y, uint32_t x1, uint32_t x2, dither_palette palette)
+{
+    uint32_t x = x1;
+    const uint32_t* luma_row = thresholds.luma[y & 7];
+    const uint32_t* channel_row = thresholds.channels[y & 7];
+
+#if defined(__ARM_NEON)
+    const uint32x4_t alpha = vdupq_n_u32(0xff000000u);
+    const uint32x4_t byte_mask = vdupq_n_u32(0xff);
+    for (; x + 3 <= x2; x += 4) {
+        uint32x4_t pixels = vld1q_u32(line + x);
+        uint32x4_t result;
+        if (palette == dither_palette::BLACK_WHITE) {
+            uint32x4_t sum = vmulq_n_u32(vandq_u32(pixels, byte_mask), 29);
+            sum = vmlaq_n_u32(sum, vandq_u32(vshrq_n_u32(pixels, 8), byte_mask), 150);
+            sum = vmlaq_n_u32(sum, vandq_u32(vshrq_n_u32(pixels, 16), byte_mask), 77);
+            uint32x4_t set = vcgtq_u32(vshrq_n_u32(sum, 8), vld1q_u32(luma_row + (x & 7)));
+            result = vorrq_u32(alpha, set);
+        } else {
+            uint8x16_t threshold = vreinterpretq_u8_u32(vld1q_u32(channel_row + (x & 7)));
+            uint8x16_t set = vcgeq_u8(vreinterpretq_u8_u32(pixels), threshold);
+            result = vorrq_u32(alpha, vreinterpretq_u32_u8(set));
+        }
+        vst1q_u32(line + x, result);
+    }
+#elif defined(__SSE2__)
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+    const __m128i byte_mask = _mm_set1_epi32(0xff);
+    for (; x + 3 <= x2; x += 4) {
+        auto address = reinterpret_cast<__m128i*>(line + x);
+        __m128i pixels = _mm_loadu_si128(address);
+        __m128i result;
+        if (palette == dither_palette::BLACK_WHITE) {
+            // channels sit in the low 16 bits of each lane, so 16-bit multiplies can't overflow into the next lane
+            __m128i b = _mm_and_si128(pixels, byte_mask);
+            __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), byte_mask);
+            __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), byte_mask);
+            __m128i sum = _mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(77)), _mm_mullo_epi16(g, _mm_set1_epi32(150)));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi16(b, _mm_set1_epi32(29)));
+            __m128i threshold = _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma_row + (x & 7)));
+            result = _mm_or_si128(alpha, _mm_cmpgt_epi32(_mm_srli_epi32(sum, 8), threshold));
+        } else {
+            // unsigned a >= b is max(a, b) == a
+            __m128i threshold = _mm_loadu_si128(reinterpret_cast<const __m128i*>(channel_row + (x & 7)));
+            __m128i set = _mm_cmpeq_epi8(_mm_max_epu8(pixels, threshold), pixels);
+            result = _mm_or_si128(alpha, set);
+        }
+        _mm_storeu_si128(address, result);
+    }
+#endif
+
+    for (; x <= x2; x++) {
+        line[x] = ordered_pixel(line[x], x, y, palette);
+    }
+}
+
+inline int16_t quantize(int value)
+{
+    return value >= 128 ? 255 : 0;
+}
+
+}
+
+dither_mode dither_mode_for(refresh_type type)
+{
+    switch (type) {
+    case MONOCHROME:
+        return { dither_method::ORDERED, dither_palette::BLACK_WHITE };
+    case COLOR_ANIMATION:
+        return { dither_method::ORDERED, dither_palette::PRIMARIES };
+    default:
+        return { dither_method::ERROR_DIFFUSION, dither_palette::PRIMARIES };
+    }
+}
+
+ditherer::ditherer(uint32_t width)
+    : error_current((width + 2) * 3)
+    , error_next((width + 2) * 3)
+{
+}
+
+void ditherer::dither_row(uint32_t* line, uint32_t y, uint32_t x1, uint32_t x2)
+{
+    if (mode.method == dither_method::ORDERED) {
+        ordered_row(line, y, x1, x2, mode.palette);
+    } else {
+        diffuse_row(line, y, x1, x2);
+    }
+}
+
+void ditherer::dither_region(uint8_t* data, uint32_t stride, rect region)
+{
+    for (uint32_t y = region.p1.y; y <= region.p2.y; y++) {
+        dither_row(reinterpret_cast<uint32_t*>(data + y * stride), y, region.p1.x, region.p2.x);
+    }
+}
+
+// Floyd-Steinberg is sequential along the row, so this stays scalar
+void ditherer::diffuse_row(uint32_t* line, uint32_t y, uint32_t x1, uint32_t x2)
+{
+    // error index of pixel x and channel c is (x + 1) * 3 + c; the padding absorbs the row ends
+    size_t begin = x1 * 3;
+    size_t end = (x2 + 3) * 3;
+    auto clear = [](std::vector<int16_t>& errors, size_t from, size_t to) {
+        if (from < to) {
+            std::memset(errors.data() + from, 0, (to - from) * sizeof(int16_t));
+        }
+    };
+
+    if (y == last_row + 1) {
+        // only the previous segment's footprint carries fresh error into this row
+        std::swap(error_current, error_next);
+        clear(error_current, begin, std::min(end, last_begin));
+        clear(error_current, std::max(begin, last_end), end);
+    } else {
+        clear(error_current, begin, end);
+    }
+    clear(error_next, begin, end);
+    last_row = y;
+    last_begin = begin;
+    last_end = end;
+
+    int channels = mode.palette == dither_palette::BLACK_WHITE ? 1 : 3;
+    for (uint32_t x = x1; x <= x2; x++) {
+        uint32_t pixel = line[x];
+        uint32_t result = 0xff000000u;
+        int16_t* current = &error_current[(x + 1) * 3];
+        int16_t* next = &error_next[(x + 1) * 3];
+
+        for (int c = 0; c < channels; c++) {
+            int value = channels == 1 ? luma(pixel) : (pixel >> (c * 8)) & 0xff;
+            value += current[c];
+            int16_t quantized = quantize(value);
+            int error = value - quantized;
+
+            current[c + 3] += error * 7 / 16;
+            next[c - 3] += error * 3 / 16;
+            next[c] += error * 5 / 16;
+            next[c + 3] += error / 16;
+
+            result |= static_cast<uint32_t>(quantized) << (c * 8);
+        }
+        if (channels == 1 && result != 0xff000000u) {
+            result = 0xffffffffu;
+        }
+        line[x] = result;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef DITHER_H
+#define DITHER_H
+
+#include "data_structs.h"
+
+#include <bifrost/global_constants.h>
+#include <cstdint>
+#include <vector>
+
+enum class dither_method : uint8_t {
+    // 8x8 Bayer thresholds anchored to screen coordinates; stable from frame to frame
+    ORDERED,
+    // Floyd-Steinberg; smoother gradients, but a change ripples to the right and down
+    ERROR_DIFFUSION,
+};
+
+enum class dither_palette : uint8_t {
+    // luma quantized to pure black and white
+    BLACK_WHITE,
+    // every channel quantized to 0 or 255: black, white and the six Gallery 3 primaries
+    PRIMARIES,
+};
+
+struct dither_mode {
+    dither_method method;
+    dither_palette palette;
+};
+
+// Ordered dithering for animation and monochrome updates, error diffusion for content.
+dither_mode dither_mode_for(refresh_type type);
+
+// Quantizes ARGB8888 pixels in place to a palette the fast waveforms can show.
+class ditherer {
+public:
+    explicit ditherer(uint32_t width);
+
+    void set_mode(dither_mode mode) { this->mode = mode; }
+    dither_mode get_mode() const { return mode; }
+
+    // Dither the inclusive segment x1..x2 of row y, where line points at the start of the row.
+    // Error diffusion carries its error into the next call only if that call is for row y + 1.
+    void dither_row(uint32_t* line, uint32_t y, uint32_t x1, uint32_t x2);
+
+    // Dither an inclusive region of an image, top to bottom.
+    void dither_region(uint8_t* data, uint32_t stride, rect region);
+
+private:
+    dither_mode mode { dither_method::ORDERED, dither_palette::BLACK_WHITE };
+
+    // three channels per pixel plus one pixel of padding on each side
+    std::vector<int16_t> error_current;
+    std::vector<int16_t> error_next;
+    int64_t last_row = -2;
+    size_t last_begin = 0;
+    size_t last_end = 0;
+
+    void diffuse_row(uint32_t* line, uint32_t y, uint32_t x1, uint32_t x2);
+};
+
+#endif // DITHER_H
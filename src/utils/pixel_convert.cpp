@@ -0,0 +1,103 @@
+#include "pixel_convert.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void expand_l8_to_argb8888(const uint8_t* src, uint32_t* dst, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__ARM_NEON)
+    // vst4 interleaves the planes into B, G, R, A bytes, i.e. little-endian 0xAARRGGBB
+    const uint8x16_t alpha = vdupq_n_u8(0xff);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t gray = vld1q_u8(src + i);
+        uint8x16x4_t pixels = { { gray, gray, gray, alpha } };
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + i), pixels);
+    }
+#elif defined(__SSE2__)
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+    for (; i + 16 <= count; i += 16) {
+        __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // gg pairs and g-alpha pairs, then interleaved into g g g ff per pixel
+        __m128i gg_lo = _mm_unpacklo_epi8(gray, gray);
+        __m128i gg_hi = _mm_unpackhi_epi8(gray, gray);
+        __m128i ga_lo = _mm_unpacklo_epi8(gray, alpha);
+        __m128i ga_hi = _mm_unpackhi_epi8(gray, alpha);
+        auto out = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg_lo, ga_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(gg_hi, ga_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(gg_hi, ga_hi));
+    }
+#endif
+
+    for (; i < count; i++) {
+        dst[i] = 0xff000000u | src[i] * 0x010101u;
+    }
+}
+
+void expand_bgr888_to_argb8888(const uint8_t* src, uint32_t* dst, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__ARM_NEON)
+    const uint8x16_t alpha = vdupq_n_u8(0xff);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t bgr = vld3q_u8(src + i * 3);
+        uint8x16x4_t pixels = { { bgr.val[0], bgr.val[1], bgr.val[2], alpha } };
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + i), pixels);
+    }
+#endif
+
+    // SSE2 has no byte shuffle to pull triplets apart; the scalar loop is load/store bound anyway
+    for (; i < count; i++) {
+        const uint8_t* p = src + i * 3;
+        dst[i] = 0xff000000u | p[2] << 16 | p[1] << 8 | p[0];
+    }
+}
+
+void reduce_argb8888_to_l8(const uint32_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__ARM_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t bgra = vld4q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        uint16x8_t lo = vmull_u8(vget_low_u8(bgra.val[2]), vdup_n_u8(77));
+        uint16x8_t hi = vmull_u8(vget_high_u8(bgra.val[2]), vdup_n_u8(77));
+        lo = vmlal_u8(lo, vget_low_u8(bgra.val[1]), vdup_n_u8(150));
+        hi = vmlal_u8(hi, vget_high_u8(bgra.val[1]), vdup_n_u8(150));
+        lo = vmlal_u8(lo, vget_low_u8(bgra.val[0]), vdup_n_u8(29));
+        hi = vmlal_u8(hi, vget_high_u8(bgra.val[0]), vdup_n_u8(29));
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+#elif defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i round = _mm_set1_epi32(128);
+    auto luma = [&](__m128i p) {
+        // each product fits in the low 16 bits of its 32-bit lane, so 16-bit multiplies are exact
+        __m128i b = _mm_mullo_epi16(_mm_and_si128(p, mask), _mm_set1_epi32(29));
+        __m128i g = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(p, 8), mask), _mm_set1_epi32(150));
+        __m128i r = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(p, 16), mask), _mm_set1_epi32(77));
+        return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(r, g), _mm_add_epi32(b, round)), 8);
+    };
+    for (; i + 16 <= count; i += 16) {
+        auto in = reinterpret_cast<const __m128i*>(src + i);
+        __m128i y0 = luma(_mm_loadu_si128(in));
+        __m128i y1 = luma(_mm_loadu_si128(in + 1));
+        __m128i y2 = luma(_mm_loadu_si128(in + 2));
+        __m128i y3 = luma(_mm_loadu_si128(in + 3));
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint32_t p = src[i];
+        dst[i] = static_cast<uint8_t>(((p >> 16 & 0xff) * 77 + (p >> 8 & 0xff) * 150 + (p & 0xff) * 29 + 128) >> 8);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Expand count L8 gray pixels into opaque ARGB8888 (QRgb) pixels.
+void expand_l8_to_argb8888(const uint8_t* src, uint32_t* dst, size_t count);
+
+// Expand count B, G, R byte triplets (TGA order) into opaque ARGB8888 pixels.
+void expand_bgr888_to_argb8888(const uint8_t* src, uint32_t* dst, size_t count);
+
+// Reduce count ARGB8888 pixels to L8 with the BT.601 luma weights; alpha is ignored.
+void reduce_argb8888_to_l8(const uint32_t* src, uint8_t* dst, size_t count);
+
+#endif // PIXEL_CONVERT_H
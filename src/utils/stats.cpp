@@ -0,0 +1,29 @@
+#include "stats.h"
+
+#include <spdlog/spdlog.h>
+
+stats::registry& stats::instance()
+{
+    static registry instance;
+    return instance;
+}
+
+stats::counter& stats::get(const std::string& name)
+{
+    auto& reg = instance();
+    std::lock_guard lock(reg.mutex);
+    auto& entry = reg.counters[name];
+    if (!entry) {
+        entry = std::make_unique<counter>();
+    }
+    return *entry;
+}
+
+void stats::log()
+{
+    auto& reg = instance();
+    std::lock_guard lock(reg.mutex);
+    for (const auto& [name, value] : reg.counters) {
+        spdlog::info("{}: {}", name, value->get());
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Process-wide named counters. They are cheap to update from any thread
+// and are logged periodically by the compositor next to the FPS counter.
+class stats {
+public:
+    class counter {
+    public:
+        void add(int64_t v) { value.fetch_add(v, std::memory_order_relaxed); }
+        void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+        void update_max(int64_t v)
+        {
+            auto current = value.load(std::memory_order_relaxed);
+            while (v > current && !value.compare_exchange_weak(current, v, std::memory_order_relaxed)) {
+            }
+        }
+        int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> value { 0 };
+    };
+
+    // Returns the counter registered under name, creating it on first use.
+    // The reference stays valid for the lifetime of the process.
+    static counter& get(const std::string& name);
+
+    static void log();
+
+private:
+    struct registry {
+        std::mutex mutex;
+        std::map<std::string, std::unique_ptr<counter>> counters;
+    };
+    static registry& instance();
+};
+
+#endif // STATS_H
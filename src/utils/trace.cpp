@@ -0,0 +1,168 @@
+#include "trace.h"
+
+#include "stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+int bifrost_trace_enabled = 0;
+
+namespace {
+
+constexpr size_t CAPACITY = 1 << 16;
+constexpr int MAX_DEPTH = 64;
+constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(100);
+
+struct event {
+    // index + 1 once the slot holds event number index; tells the writer the slot is complete
+    std::atomic<uint64_t> sequence { 0 };
+    const char* name;
+    uint64_t timestamp_ns;
+    uint64_t duration_ns;
+    uint32_t thread;
+};
+
+// spans begun on this thread and not yet ended, innermost last
+struct open_spans {
+    uint64_t start_ns[MAX_DEPTH];
+    int depth = 0;
+};
+
+thread_local open_spans spans;
+
+struct trace_state {
+    std::unique_ptr<event[]> events;
+    std::atomic<uint64_t> write_index { 0 };
+    std::atomic<uint64_t> read_index { 0 };
+    std::chrono::steady_clock::time_point epoch;
+
+    FILE* file = nullptr;
+    bool first_event = true;
+    std::thread writer;
+    std::atomic<bool> running { false };
+};
+
+trace_state state;
+
+uint32_t current_thread_id()
+{
+    static thread_local uint32_t id = static_cast<uint32_t>(syscall(SYS_gettid));
+    return id;
+}
+
+uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - state.epoch).count();
+}
+
+void push(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+    static auto& dropped = stats::get("trace.dropped_events");
+
+    // claim a slot unless the writer is a whole buffer behind
+    auto index = state.write_index.load(std::memory_order_relaxed);
+    do {
+        if (index - state.read_index.load(std::memory_order_acquire) >= CAPACITY) {
+            dropped.add(1);
+            return;
+        }
+    } while (!state.write_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+
+    auto& e = state.events[index % CAPACITY];
+    e.name = name;
+    e.timestamp_ns = start_ns;
+    e.duration_ns = end_ns - start_ns;
+    e.thread = current_thread_id();
+    e.sequence.store(index + 1, std::memory_order_release);
+}
+
+// write every completed event in order; stops at the first slot still being filled
+void write_events()
+{
+    auto read = state.read_index.load(std::memory_order_relaxed);
+    while (true) {
+        auto& e = state.events[read % CAPACITY];
+        if (e.sequence.load(std::memory_order_acquire) != read + 1) {
+            break;
+        }
+
+        // names are identifiers or literals from our own code and lvgl, so they need no escaping
+        std::fprintf(state.file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                     state.first_event ? "" : ",\n", e.name, e.timestamp_ns / 1000.0, e.duration_ns / 1000.0, getpid(), e.thread);
+        state.first_event = false;
+
+        read++;
+        state.read_index.store(read, std::memory_order_release);
+    }
+    std::fflush(state.file);
+}
+
+}
+
+// spans nest per thread, so an end always closes the innermost open span
+extern "C" void bifrost_trace_begin(const char*)
+{
+    if (spans.depth < MAX_DEPTH) {
+        spans.start_ns[spans.depth] = now_ns();
+    }
+    spans.depth++;
+}
+
+extern "C" void bifrost_trace_end(const char* name)
+{
+    // an end without a begin: the span was already open when tracing started
+    if (spans.depth == 0) {
+        return;
+    }
+    spans.depth--;
+    if (spans.depth < MAX_DEPTH) {
+        push(name, spans.start_ns[spans.depth], now_ns());
+    }
+}
+
+bool trace_start(const char* path)
+{
+    state.file = std::fopen(path, "w");
+    if (!state.file) {
+        spdlog::error("Failed to open trace file {}", path);
+        return false;
+    }
+    // JSON array format; the closing bracket is optional, so a killed process still leaves a usable trace
+    std::fputs("[\n", state.file);
+
+    state.events = std::make_unique<event[]>(CAPACITY);
+    state.epoch = std::chrono::steady_clock::now();
+    state.running = true;
+    state.writer = std::thread([] {
+        while (state.running) {
+            write_events();
+            std::this_thread::sleep_for(WRITE_INTERVAL);
+        }
+    });
+
+    __atomic_store_n(&bifrost_trace_enabled, 1, __ATOMIC_RELAXED);
+    spdlog::info("Writing trace to {}", path);
+    return true;
+}
+
+void trace_stop()
+{
+    if (!state.file) {
+        return;
+    }
+
+    // the event buffer stays allocated in case a thread is still inside push()
+    __atomic_store_n(&bifrost_trace_enabled, 0, __ATOMIC_RELAXED);
+    state.running = false;
+    state.writer.join();
+    write_events();
+    std::fputs("\n]\n", state.file);
+    std::fclose(state.file);
+    state.file = nullptr;
+}
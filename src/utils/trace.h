@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Span tracing into a lock-free ring buffer, written out as a Chrome/Perfetto
+ * JSON trace. Plain C so that lvgl's profiler macros can point at it
+ * (see LV_PROFILER_INCLUDE in lv_conf.h). Names must be string literals or
+ * otherwise outlive the trace. Each span is recorded as one complete event
+ * when it ends, so a full buffer drops whole spans. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* toggled by trace_start/trace_stop while traced threads run: access it atomically */
+extern int bifrost_trace_enabled;
+
+void bifrost_trace_begin(const char* name);
+void bifrost_trace_end(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define BIFROST_TRACE_BEGIN(name)           \
+    do {                                    \
+        if (__atomic_load_n(&bifrost_trace_enabled, __ATOMIC_RELAXED)) \
+            bifrost_trace_begin(name);      \
+    } while (0)
+
+#define BIFROST_TRACE_END(name)             \
+    do {                                    \
+        if (__atomic_load_n(&bifrost_trace_enabled, __ATOMIC_RELAXED)) \
+            bifrost_trace_end(name);        \
+    } while (0)
+
+#ifdef __cplusplus
+
+// Start writing events to a JSON trace file; enables tracing. Returns false if the file can't be opened.
+bool trace_start(const char* path);
+// Write out the remaining events and close the file.
+void trace_stop();
+
+// Traces the enclosing scope.
+class trace_span {
+public:
+    explicit trace_span(const char* name)
+        : name(name)
+    {
+        BIFROST_TRACE_BEGIN(name);
+    }
+    ~trace_span() { BIFROST_TRACE_END(name); }
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+
+private:
+    const char* name;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace_span TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#endif
+
+#endif /* TRACE_H */
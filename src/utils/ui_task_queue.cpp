@@ -0,0 +1,159 @@
+#include "ui_task_queue.h"
+
+#include "stats.h"
+
+#include <spdlog/spdlog.h>
+
+namespace {
+
+int64_t to_us(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+}
+
+ui_task_queue::ui_task_queue()
+    : head(&stub)
+    , tail(&stub)
+    , owner(std::this_thread::get_id())
+{
+}
+
+ui_task_queue::~ui_task_queue()
+{
+    // tasks that never got to run are dropped; their futures report a broken promise
+    while (auto n = pop()) {
+        delete n;
+    }
+}
+
+void ui_task_queue::bind_to_current_thread()
+{
+    owner = std::this_thread::get_id();
+}
+
+bool ui_task_queue::on_owner_thread() const
+{
+    return owner.load() == std::this_thread::get_id();
+}
+
+bool ui_task_queue::inline_allowed() const
+{
+    return on_owner_thread();
+}
+
+void ui_task_queue::post(std::function<void()> fn)
+{
+    auto n = new node;
+    n->fn = std::move(fn);
+    n->queued_at = std::chrono::steady_clock::now();
+    push(n);
+}
+
+void ui_task_queue::dispatch(std::function<void()> fn)
+{
+    if (inline_allowed()) {
+        fn();
+        return;
+    }
+    post(std::move(fn));
+}
+
+void ui_task_queue::push(node* n)
+{
+    n->next.store(nullptr, std::memory_order_relaxed);
+    auto prev = head.exchange(n, std::memory_order_seq_cst);
+    prev->next.store(n, std::memory_order_release);
+
+    if (n != &stub && owner_waiting.load(std::memory_order_seq_cst)) {
+        // taking the mutex orders the notify after the owner has started waiting
+        { std::lock_guard lock(wake_mutex); }
+        wake.notify_one();
+    }
+}
+
+bool ui_task_queue::has_tasks() const
+{
+    // tail is the next node to run unless it is the stub; head moves as soon as a producer pushes
+    return tail != &stub || head.load(std::memory_order_seq_cst) != &stub;
+}
+
+void ui_task_queue::wait_for_tasks(std::chrono::steady_clock::duration timeout)
+{
+    std::unique_lock lock(wake_mutex);
+    owner_waiting.store(true, std::memory_order_seq_cst);
+    wake.wait_for(lock, timeout, [this] { return has_tasks(); });
+    owner_waiting.store(false, std::memory_order_relaxed);
+}
+
+ui_task_queue::node* ui_task_queue::pop()
+{
+    auto t = tail;
+    auto next = t->next.load(std::memory_order_acquire);
+    if (t == &stub) {
+        if (!next) {
+            return nullptr;
+        }
+        tail = next;
+        t = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        tail = next;
+        return t;
+    }
+
+    // t is the last node; a producer may be between its exchange and its link
+    if (t != head.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    push(&stub);
+    next = t->next.load(std::memory_order_acquire);
+    if (next) {
+        tail = next;
+        return t;
+    }
+    return nullptr;
+}
+
+size_t ui_task_queue::drain()
+{
+    static auto& tasks = stats::get("ui_queue.tasks");
+    static auto& latency_total = stats::get("ui_queue.latency_us_total");
+    static auto& latency_max = stats::get("ui_queue.latency_us_max");
+    static auto& drain_max = stats::get("ui_queue.drain_us_max");
+
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    while (auto n = pop()) {
+        auto latency = to_us(std::chrono::steady_clock::now() - n->queued_at);
+        latency_total.add(latency);
+        latency_max.update_max(latency);
+
+        try {
+            n->fn();
+        } catch (const std::exception& e) {
+            spdlog::error("UI task failed: {}", e.what());
+        }
+        delete n;
+        count++;
+    }
+
+    if (count > 0) {
+        tasks.add(count);
+        drain_max.update_max(to_us(std::chrono::steady_clock::now() - start));
+    }
+    return count;
+}
+
+void ui_task_queue::record_caller_wait(std::chrono::steady_clock::duration wait)
+{
+    static auto& wait_total = stats::get("ui_queue.caller_wait_us_total");
+    static auto& wait_max = stats::get("ui_queue.caller_wait_us_max");
+
+    wait_total.add(to_us(wait));
+    wait_max.update_max(to_us(wait));
+}
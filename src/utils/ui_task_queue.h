@@ -0,0 +1,97 @@
+#ifndef UI_TASK_QUEUE_H
+#define UI_TASK_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+// Lock-free multi-producer single-consumer queue of closures for the thread
+// that owns LVGL. Any thread may queue work; only the owner drains it, so
+// LVGL is never touched concurrently and nobody holds a lock across a frame.
+class ui_task_queue {
+public:
+    ui_task_queue();
+    ~ui_task_queue();
+
+    ui_task_queue(const ui_task_queue&) = delete;
+    ui_task_queue& operator=(const ui_task_queue&) = delete;
+
+    // The thread that creates the queue owns it until another one binds itself; the render
+    // thread calls this once, before any other thread may touch LVGL.
+    void bind_to_current_thread();
+    bool on_owner_thread() const;
+
+    // Queue fn for the owner thread without waiting for it.
+    void post(std::function<void()> fn);
+
+    // Run fn inline on the owner thread, otherwise post it.
+    void dispatch(std::function<void()> fn);
+
+    // Queue fn for the owner thread; the future carries its result or exception.
+    template <typename F>
+    auto submit(F&& fn) -> std::future<std::invoke_result_t<F>>
+    {
+        using result_type = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<F>(fn));
+        auto future = task->get_future();
+        post([task] { (*task)(); });
+        return future;
+    }
+
+    // Run fn on the owner thread and wait for the result. Runs inline when
+    // called from the owner thread.
+    template <typename F>
+    auto run(F&& fn) -> std::invoke_result_t<F>
+    {
+        if (inline_allowed()) {
+            return fn();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto future = submit(std::forward<F>(fn));
+        future.wait();
+        record_caller_wait(std::chrono::steady_clock::now() - start);
+        return future.get();
+    }
+
+    // Run everything queued so far; owner thread only. Returns the number of tasks run.
+    size_t drain();
+
+    // Sleep until a task is queued or the timeout passes; owner thread only.
+    void wait_for_tasks(std::chrono::steady_clock::duration timeout);
+
+private:
+    struct node {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point queued_at;
+        std::atomic<node*> next { nullptr };
+    };
+
+    // producers swap themselves into head; the consumer walks from tail
+    std::atomic<node*> head;
+    node* tail;
+    node stub;
+    std::atomic<std::thread::id> owner;
+
+    // producers only touch the mutex while the owner is actually waiting
+    std::atomic<bool> owner_waiting { false };
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+
+    bool inline_allowed() const;
+    bool has_tasks() const;
+    void push(node* n);
+    node* pop();
+    void record_caller_wait(std::chrono::steady_clock::duration wait);
+};
+
+// all LVGL access goes through this queue and runs on the render thread
+inline ui_task_queue g_ui_tasks;
+
+#endif // UI_TASK_QUEUE_H
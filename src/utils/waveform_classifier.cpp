@@ -0,0 +1,72 @@
+#include "waveform_classifier.h"
+
+void content_histogram::add(pixel_content content)
+{
+    switch (content) {
+    case pixel_content::BLACK_WHITE:
+        black_white++;
+        break;
+    case pixel_content::GRAYSCALE:
+        grayscale++;
+        break;
+    case pixel_content::PALETTE:
+        palette++;
+        break;
+    case pixel_content::COLOR:
+        color++;
+        break;
+    default:
+        break;
+    }
+}
+
+pixel_content content_histogram::content() const
+{
+    if (color > 0) {
+        return pixel_content::COLOR;
+    }
+    if (palette > 0) {
+        return pixel_content::PALETTE;
+    }
+    if (grayscale > 0) {
+        return pixel_content::GRAYSCALE;
+    }
+    return black_white > 0 ? pixel_content::BLACK_WHITE : pixel_content::NONE;
+}
+
+content_histogram histogram_argb8888(const uint8_t* data, uint32_t stride, extent size, rect region)
+{
+    content_histogram histogram;
+    if (size.x == 0 || size.y == 0 || region.p1.x >= size.x || region.p1.y >= size.y) {
+        return histogram;
+    }
+
+    uint32_t x2 = std::min(region.p2.x, size.x - 1);
+    uint32_t y2 = std::min(region.p2.y, size.y - 1);
+    for (uint32_t y = region.p1.y; y <= y2; y++) {
+        auto line = reinterpret_cast<const uint32_t*>(data + y * stride);
+        for (uint32_t x = region.p1.x; x <= x2; x++) {
+            histogram.add(classify_pixel(line[x]));
+        }
+
+        // nothing can make the region more demanding than color
+        if (histogram.color > 0) {
+            break;
+        }
+    }
+    return histogram;
+}
+
+refresh_type fastest_refresh_type(pixel_content content)
+{
+    switch (content) {
+    case pixel_content::COLOR:
+        return COLOR_CONTENT;
+    case pixel_content::PALETTE:
+    case pixel_content::GRAYSCALE:
+        // the monochrome waveform only drives pure black and white
+        return COLOR_FAST;
+    default:
+        return MONOCHROME;
+    }
+}
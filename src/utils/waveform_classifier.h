@@ -0,0 +1,53 @@
+#ifndef WAVEFORM_CLASSIFIER_H
+#define WAVEFORM_CLASSIFIER_H
+
+#include "data_structs.h"
+
+#include <bifrost/global_constants.h>
+#include <cstdint>
+
+// What a pixel (or a region of pixels) needs from the panel, ordered from
+// the cheapest to the most demanding so that std::max combines them.
+enum class pixel_content : uint8_t {
+    NONE = 0,
+    BLACK_WHITE = 1,
+    GRAYSCALE = 2,
+    // only the corners of the RGB cube, as left behind by dithering to the panel primaries
+    PALETTE = 3,
+    COLOR = 4,
+};
+
+inline pixel_content classify_pixel(uint32_t argb)
+{
+    uint32_t rgb = argb & 0x00ffffff;
+    if (rgb == 0 || rgb == 0x00ffffff) {
+        return pixel_content::BLACK_WHITE;
+    }
+
+    uint8_t r = rgb >> 16;
+    uint8_t g = rgb >> 8;
+    uint8_t b = rgb;
+    if (r == g && g == b) {
+        return pixel_content::GRAYSCALE;
+    }
+    auto saturated = [](uint8_t c) { return c == 0 || c == 0xff; };
+    return saturated(r) && saturated(g) && saturated(b) ? pixel_content::PALETTE : pixel_content::COLOR;
+}
+
+struct content_histogram {
+    uint32_t black_white = 0;
+    uint32_t grayscale = 0;
+    uint32_t palette = 0;
+    uint32_t color = 0;
+
+    void add(pixel_content content);
+    pixel_content content() const;
+};
+
+// Histogram the ARGB8888 pixels of an inclusive region of an image.
+content_histogram histogram_argb8888(const uint8_t* data, uint32_t stride, extent size, rect region);
+
+// The fastest refresh type whose waveform in compositor::refresh() can show the content correctly.
+refresh_type fastest_refresh_type(pixel_content content);
+
+#endif // WAVEFORM_CLASSIFIER_H